@@ -1,71 +1,1084 @@
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cctype>
+#include <cerrno>
+#include <chrono>
+#include <condition_variable>
+#include <csignal>
+#include <cstddef>
+#include <deque>
 #include <filesystem>
 #include <fstream>
+#include <functional>
+#include <iomanip>
 #include <iostream>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <numeric>
+#include <optional>
 #include <ranges>
 #include <regex>
+#include <span>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
 
 #include <opencv2/core/utils/logger.hpp>
 #include <opencv2/imgcodecs/imgcodecs.hpp>
+#include <opencv2/imgproc/imgproc.hpp>
+
+#if __has_include(<sys/un.h>)
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+#define DOC_COLOR_DECOMPOSER_APP_SOCKETS
+#endif
 
 #include "doc_color_decomposer/doc_color_decomposer.h"
+#include "doc_color_decomposer/search.h"
+#include "doc_color_decomposer/thread_pool.h"
 
-int main(int argc, char** argv) {
-  std::vector<std::string> args(argv + 1, argv + argc);
+namespace {
 
-  if (args.size() >= 2) {
-    std::filesystem::path src_path = args[0];
-    std::filesystem::path dst_path = args[1];
+struct Options {
+  std::filesystem::path groundtruth = "";
+  std::filesystem::path stats = "";
+  std::filesystem::path trace = "";
+  std::filesystem::path model = "";
+  std::filesystem::path export_model = "";
+  std::filesystem::path connect = "";
+  int tolerance = 35;
+  int strip_rows = 0;
+  int jobs = 0;
+  int threads = 0;
+  int pyramid = 0;
+  int queue = 0;
+
+  bool nopreprocess = false;
+  bool vectorize = false;
+  bool masking = false;
+  bool sparse = false;
+  bool labeling = false;
+  bool container = false;
+  bool visualize = false;
+  bool drift = false;
+
+  doc_color_decomposer::Sampling sampling = doc_color_decomposer::Sampling::kFull;
+  double sample_density = 0.05;
+
+  std::optional<doc_color_decomposer::ClusterModel> cluster_model;
+
+  bool search = false;
+  std::vector<int> search_tolerances = {35};
+  std::vector<double> search_peak_factors = {0.025};
+  std::vector<double> search_saturation_threshs = {10.0};
+  std::vector<double> search_lightness_threshs = {50.0};
+};
+
+struct Status {
+  std::filesystem::path src_path;
+  std::filesystem::path groundtruth = "";
+  std::string error = "";
+  doc_color_decomposer::Stats stats;
+  double seconds = 0.0;
+};
+
+struct Document {
+  std::size_t idx = 0;
+  std::chrono::steady_clock::time_point start;
+  cv::Mat src;
+  cv::Mat thumbnail;
+  cv::Mat truth_labels;
+  std::vector<doc_color_decomposer::SparseMask> truth_masks;
+  std::string error = "";
+};
+
+struct Encoding {
+  std::filesystem::path dst_path;
+  cv::Mat image;
+};
+
+template <typename T>
+class BoundedQueue {
+ public:
+  explicit BoundedQueue(std::size_t capacity) : capacity_(std::max(capacity, 1uz)) {}
+
+  void Push(T item) {
+    std::unique_lock lock(mutex_);
+    not_full_cv_.wait(lock, [this] { return items_.size() < capacity_; });
+
+    items_.push_back(std::move(item));
+    not_empty_cv_.notify_one();
+  }
+
+  bool TryPush(T item) {
+    std::lock_guard lock(mutex_);
+    if (items_.size() >= capacity_) {
+      return false;
+    }
+
+    items_.push_back(std::move(item));
+    not_empty_cv_.notify_one();
+
+    return true;
+  }
+
+  void Close() {
+    std::lock_guard lock(mutex_);
+    closed_ = true;
+    not_empty_cv_.notify_all();
+  }
+
+  std::optional<T> Pop() {
+    std::unique_lock lock(mutex_);
+    not_empty_cv_.wait(lock, [this] { return closed_ || !items_.empty(); });
+
+    if (items_.empty()) {
+      return std::nullopt;
+    }
+
+    T item = std::move(items_.front());
+    items_.pop_front();
+    not_full_cv_.notify_one();
+
+    return item;
+  }
+
+  std::size_t Size() {
+    std::lock_guard lock(mutex_);
+    return items_.size();
+  }
+
+ private:
+  std::size_t capacity_;
+  std::deque<T> items_;
+  std::mutex mutex_;
+  std::condition_variable not_full_cv_;
+  std::condition_variable not_empty_cv_;
+  bool closed_ = false;
+};
+
+class WorkspacePool {
+ public:
+  explicit WorkspacePool(std::size_t max_idle) : max_idle_(max_idle) {}
+
+  std::unique_ptr<doc_color_decomposer::DocColorDecomposer> Acquire() {
+    std::lock_guard lock(mutex_);
+    if (idle_.empty()) {
+      return nullptr;
+    }
+
+    std::unique_ptr<doc_color_decomposer::DocColorDecomposer> workspace = std::move(idle_.back());
+    idle_.pop_back();
+
+    return workspace;
+  }
 
-    std::filesystem::path groundtruth = "";
-    int tolerance = 35;
+  void Release(std::unique_ptr<doc_color_decomposer::DocColorDecomposer> workspace) {
+    std::lock_guard lock(mutex_);
+    if (idle_.size() < max_idle_) {
+      idle_.push_back(std::move(workspace));
+    }
+  }
 
-    bool nopreprocess = false;
-    bool masking = false;
-    bool visualize = false;
+ private:
+  std::size_t max_idle_;
+  std::vector<std::unique_ptr<doc_color_decomposer::DocColorDecomposer>> idle_;
+  std::mutex mutex_;
+};
 
-    for (const auto& arg : args | std::views::drop(2)) {
-      if (std::regex_match(arg, std::regex("^--groundtruth=.+$"))) {
-        groundtruth = arg.substr(std::string("--groundtruth=").size());
-      } else if (std::regex_match(arg, std::regex("^--tolerance=[0-9]*[13579]$"))) {
-        tolerance = std::stoi(arg.substr(std::string("--tolerance=").size()));
+std::vector<double> ParseList(const std::string& list) {
+  std::vector<double> values;
+  for (const auto& value : list | std::views::split(',')) {
+    values.push_back(std::stod(std::string(value.begin(), value.end())));
+  }
 
-      } else if (arg == "--nopreprocess") {
-        nopreprocess = true;
-      } else if (arg == "--masking") {
-        masking = true;
-      } else if (arg == "--visualize") {
-        visualize = true;
+  return values;
+}
+
+std::vector<int> ParseOddRanges(const std::string& list) {
+  std::vector<int> values;
+  for (const auto& range : list | std::views::split(',')) {
+    std::string range_str(range.begin(), range.end());
+    std::size_t colon = range_str.find(':');
+
+    int first = std::stoi(range_str.substr(0, colon));
+    int last = colon == std::string::npos ? first : std::stoi(range_str.substr(colon + 1));
+    for (const auto& value : std::views::iota(first, last + 1) | std::views::filter([](int v) { return v % 2 == 1; })) {
+      values.push_back(value);
+    }
+  }
+
+  return values;
+}
+
+std::regex GlobToRegex(const std::string& glob) {
+  std::string pattern;
+  for (const auto& c : glob) {
+    if (c == '*') {
+      pattern += ".*";
+    } else if (c == '?') {
+      pattern += '.';
+    } else if (std::string("\\^$.|+()[]{}").contains(c)) {
+      pattern += std::string("\\") + c;
+    } else {
+      pattern += c;
+    }
+  }
 
+  return std::regex(pattern);
+}
+
+std::vector<std::filesystem::path> CollectImages(const std::filesystem::path& src_path) {
+  std::vector<std::filesystem::path> src_paths;
+
+  if (std::filesystem::is_directory(src_path)) {
+    for (const auto& file : std::filesystem::directory_iterator(src_path)) {
+      if (file.is_regular_file() && cv::haveImageReader(file.path().string())) {
+        src_paths.push_back(file.path());
+      }
+    }
+
+  } else if (src_path.filename().string().find_first_of("*?") != std::string::npos) {
+    std::filesystem::path dir_path = src_path.has_parent_path() ? src_path.parent_path() : ".";
+    std::regex filename_regex = GlobToRegex(src_path.filename().string());
+
+    for (const auto& file : std::filesystem::directory_iterator(dir_path)) {
+      if (file.is_regular_file() && std::regex_match(file.path().filename().string(), filename_regex)) {
+        src_paths.push_back(file.path());
+      }
+    }
+
+  } else {
+    std::ifstream manifest(src_path);
+    for (std::string line; std::getline(manifest, line);) {
+      if (!line.empty() && line.back() == '\r') {
+        line.pop_back();
+      }
+      if (line.empty() || line.front() == '#') {
+        continue;
+      }
+
+      std::filesystem::path path = line;
+      src_paths.push_back(path.is_relative() ? src_path.parent_path() / path : path);
+    }
+  }
+
+  std::ranges::sort(src_paths);
+
+  return src_paths;
+}
+
+void WriteStats(std::ostream& out, const doc_color_decomposer::Stats& stats) {
+  out << "{\"pixels\": " << stats.pixels << ", \"colors\": " << stats.colors << ", \"clusters\": " << stats.clusters;
+  out << ", \"table_bytes\": " << stats.table_bytes << ", \"layer_bytes\": " << stats.layer_bytes << ", \"stages\": [";
+
+  for (const auto& [idx, stage] : stats.stages | std::views::enumerate) {
+    out << (idx > 0 ? ", " : "") << "{\"name\": \"" << stage.name << "\", \"wall_ms\": " << stage.wall_ms << ", \"cpu_ms\": " << stage.cpu_ms << '}';
+  }
+
+  out << "]}";
+}
+
+std::filesystem::path FindGroundtruth(const std::filesystem::path& groundtruth, const std::filesystem::path& src_path) {
+  std::filesystem::path truth_masks_path = groundtruth / src_path.stem();
+  if (std::filesystem::is_directory(truth_masks_path)) {
+    return truth_masks_path;
+  }
+
+  return groundtruth / (src_path.stem().string() + ".png");
+}
+
+bool IsJpeg(const std::filesystem::path& path) {
+  std::string ext = path.extension().string();
+  std::ranges::transform(ext, ext.begin(), [](unsigned char c) { return static_cast<char>(std::tolower(c)); });
+
+  return ext == ".jpg" || ext == ".jpeg" || ext == ".jpe";
+}
+
+Document DecodeDocument(std::size_t idx, const Status& status, const Options& options) {
+  Document document{.idx = idx, .start = std::chrono::steady_clock::now()};
+  if (options.strip_rows > 0) {
+    return document;
+  }
+
+  try {
+    document.src = cv::imread(status.src_path.string(), cv::IMREAD_COLOR);
+    if (options.pyramid > 0 && !options.cluster_model && !document.src.empty()) {
+      if (IsJpeg(status.src_path)) {
+        int reduced_flag = options.pyramid == 8 ? cv::IMREAD_REDUCED_COLOR_8 : options.pyramid == 4 ? cv::IMREAD_REDUCED_COLOR_4 : cv::IMREAD_REDUCED_COLOR_2;
+        document.thumbnail = cv::imread(status.src_path.string(), reduced_flag);
       } else {
-        std::cerr << "Error: invalid arguments\n";
-        std::cerr << "Checkout `./doc-color-decomposer --help`";
-        return 1;
+        cv::resize(document.src, document.thumbnail, cv::Size(), 1.0 / options.pyramid, 1.0 / options.pyramid, cv::INTER_AREA);
       }
     }
+  } catch (...) {
+  }
+  if (document.src.empty()) {
+    document.error = "invalid image";
+    return document;
+  }
+
+  try {
+    if (std::filesystem::is_regular_file(status.groundtruth)) {
+      document.truth_labels = cv::imread(status.groundtruth.string(), cv::IMREAD_GRAYSCALE);
+
+    } else if (!status.groundtruth.empty()) {
+      for (const auto& truth_mask_file : std::filesystem::directory_iterator(status.groundtruth)) {
+        document.truth_masks.emplace_back(cv::imread(truth_mask_file.path().string(), cv::IMREAD_GRAYSCALE));
+      }
+    }
+
+  } catch (...) {
+    document.error = "invalid masks";
+  }
+
+  return document;
+}
+
+bool LoadModel(Options& options) {
+  if (options.model.empty()) {
+    return true;
+  }
+
+  try {
+    options.cluster_model = doc_color_decomposer::ReadClusterModel(options.model);
+    options.cluster_model->params.threads = options.threads;
+
+  } catch (...) {
+    return false;
+  }
+
+  return true;
+}
+
+doc_color_decomposer::Params MakeParams(const Options& options) {
+  doc_color_decomposer::Params params;
+  params.tolerance = options.tolerance;
+  params.preprocessing = !options.nopreprocess;
+  params.engine = options.vectorize ? doc_color_decomposer::Engine::kVectorized : doc_color_decomposer::Engine::kReference;
+  params.sampling = options.sampling;
+  params.sample_density = options.sample_density;
+  params.threads = options.threads;
+
+  return params;
+}
+
+std::vector<Encoding> DecomposeDocument(const Document& document, Status& status, const std::filesystem::path& dst_path, const Options& options, WorkspacePool& workspaces) {
+  const std::filesystem::path& src_path = status.src_path;
 
+  doc_color_decomposer::Params params = MakeParams(options);
+
+  if (!document.error.empty()) {
+    throw std::runtime_error(document.error);
+  }
+
+  if (options.strip_rows > 0) {
+    doc_color_decomposer::DocColorDecomposer dcd;
     try {
-      if (!std::filesystem::exists(dst_path) || !std::filesystem::is_directory(dst_path)) {
-        std::filesystem::create_directory(dst_path);
+      doc_color_decomposer::PnmStripReader reader(src_path);
+      dcd = doc_color_decomposer::DocColorDecomposer(reader, params, options.strip_rows);
+
+      dcd.WriteLayers(reader, [&](int layer_idx) {
+        std::string layer_path = (dst_path / (src_path.stem().string() + "-layer-")).string() + std::to_string(layer_idx + 1) + (options.masking ? ".pgm" : ".ppm");
+        return std::make_unique<doc_color_decomposer::PnmStripWriter>(layer_path, reader.GetSize(), options.masking ? 1 : 3);
+      }, options.masking, options.strip_rows);
+
+    } catch (...) {
+      throw std::runtime_error("invalid image");
+    }
+
+    status.stats = dcd.GetStats();
+    return {};
+  }
+
+  std::unique_ptr<doc_color_decomposer::DocColorDecomposer> workspace = workspaces.Acquire();
+  try {
+    if (!document.thumbnail.empty()) {
+      doc_color_decomposer::Params coarse_params = params;
+      coarse_params.sampling = doc_color_decomposer::Sampling::kFull;
+      doc_color_decomposer::ClusterModel model = doc_color_decomposer::DocColorDecomposer::LearnModel({document.thumbnail}, coarse_params);
+
+      if (!workspace) {
+        workspace = std::make_unique<doc_color_decomposer::DocColorDecomposer>();
+      }
+      workspace->Decompose(document.src, model);
+
+    } else if (workspace && workspace->GetParams() == (options.cluster_model ? options.cluster_model->params : params)) {
+      workspace->Decompose(document.src);
+    } else if (options.cluster_model) {
+      workspace = std::make_unique<doc_color_decomposer::DocColorDecomposer>(document.src, *options.cluster_model);
+    } else {
+      workspace = std::make_unique<doc_color_decomposer::DocColorDecomposer>(document.src, params);
+    }
+
+  } catch (...) {
+    throw std::runtime_error("invalid image");
+  }
+
+  doc_color_decomposer::DocColorDecomposer& dcd = *workspace;
+
+  try {
+    if (!document.truth_labels.empty()) {
+      std::ofstream(dst_path / (src_path.stem().string() + "-quality.txt")) << dcd.ComputeQuality(document.truth_labels);
+
+    } else if (!document.truth_masks.empty()) {
+      std::ofstream(dst_path / (src_path.stem().string() + "-quality.txt")) << dcd.ComputeQuality(document.truth_masks);
+    }
+
+  } catch (...) {
+    throw std::runtime_error("invalid masks");
+  }
+
+  std::vector<Encoding> encodings;
+
+  if (options.container) {
+    dcd.WriteContainer(dst_path / (src_path.stem().string() + ".dcd"));
+
+  } else if (options.sparse) {
+    std::vector<doc_color_decomposer::SparseMask> masks = dcd.GetSparseMasks();
+
+    std::ofstream masks_file(dst_path / (src_path.stem().string() + "-masks.rle"), std::ios::binary);
+    for (const auto& mask : masks) {
+      mask.Write(masks_file);
+    }
+
+  } else if (options.labeling) {
+    encodings.push_back({dst_path / (src_path.stem().string() + "-labels.png"), dcd.GetLabels()});
+
+    std::ofstream palette(dst_path / (src_path.stem().string() + "-palette.txt"));
+    for (const auto& [r, g, b] : dcd.GetPalette()) {
+      palette << r << ' ' << g << ' ' << b << '\n';
+    }
+
+  } else {
+    for (const auto& [layer_idx, layer] : (options.masking ? dcd.GetMasks() : dcd.GetLayers()) | std::views::enumerate) {
+      encodings.push_back({(dst_path / (src_path.stem().string() + "-layer-")).string() + std::to_string(layer_idx + 1) + ".png", layer});
+    }
+  }
+
+  if (options.drift) {
+    auto drift = dcd.MeasureDrift();
+    std::ofstream(dst_path / (src_path.stem().string() + "-drift.txt")) << drift.exact_layers << ' ' << drift.approximate_layers << ' ' << drift.max_boundary_shift << ' ' << drift.relabeled_fraction;
+  }
+
+  if (options.visualize) {
+    encodings.push_back({dst_path / (src_path.stem().string() + "-plot-2d-lab.png"), dcd.Plot2DLab()});
+
+    std::ofstream plot_3d_rgb(dst_path / (src_path.stem().string() + "-plot-3d-rgb.tex"));
+    dcd.Plot3DRgb(plot_3d_rgb);
+    std::ofstream plot_1d_phi(dst_path / (src_path.stem().string() + "-plot-1d-phi.tex"));
+    dcd.Plot1DPhi(plot_1d_phi);
+    std::ofstream plot_1d_clusters(dst_path / (src_path.stem().string() + "-plot-1d-clusters.tex"));
+    dcd.Plot1DClusters(plot_1d_clusters);
+  }
+
+  if (!options.export_model.empty()) {
+    doc_color_decomposer::WriteClusterModel(options.export_model, dcd.ExportModel());
+  }
+
+  status.stats = dcd.GetStats();
+  workspaces.Release(std::move(workspace));
+
+  return encodings;
+}
+
+void WaitForInFlight(doc_color_decomposer::ThreadPool& pool, const std::atomic<int>& in_flight, int max_in_flight) {
+  for (int running = in_flight.load(std::memory_order_acquire); running > max_in_flight; running = in_flight.load(std::memory_order_acquire)) {
+    if (!pool.RunPendingTask()) {
+      in_flight.wait(running, std::memory_order_acquire);
+    }
+  }
+}
+
+void RunPipeline(std::vector<Status>& statuses, const std::filesystem::path& dst_path, const Options& options, doc_color_decomposer::ThreadPool& pool) {
+  const int kMaxInFlight = 2 * pool.CountThreads();
+
+  BoundedQueue<Document> documents(pool.CountThreads());
+  std::jthread decoder([&] {
+    for (const auto& idx : std::views::iota(0uz, statuses.size())) {
+      documents.Push(DecodeDocument(idx, statuses[idx], options));
+    }
+    documents.Close();
+  });
+
+  auto in_flight = std::make_shared<std::atomic<int>>(0);
+  std::mutex error_mutex;
+  WorkspacePool workspaces(pool.CountThreads());
+
+  auto finish = [in_flight](Status& status, std::chrono::steady_clock::time_point start) {
+    status.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    in_flight->fetch_sub(1, std::memory_order_release);
+    in_flight->notify_one();
+  };
+
+  while (auto document = documents.Pop()) {
+    WaitForInFlight(pool, *in_flight, kMaxInFlight - 1);
+
+    in_flight->fetch_add(1, std::memory_order_relaxed);
+    pool.Submit([&, finish, document = std::move(*document)] {
+      Status& status = statuses[document.idx];
+
+      std::vector<Encoding> encodings;
+      try {
+        encodings = DecomposeDocument(document, status, dst_path, options, workspaces);
+      } catch (const std::exception& e) {
+        status.error = e.what();
+      } catch (...) {
+        status.error = "unknown error";
+      }
+
+      if (encodings.empty()) {
+        finish(status, document.start);
+        return;
+      }
+
+      auto remaining = std::make_shared<std::atomic<int>>(static_cast<int>(encodings.size()));
+      for (auto& encoding : encodings) {
+        pool.Submit([&, finish, idx = document.idx, start = document.start, remaining, encoding = std::move(encoding)] {
+          Status& status = statuses[idx];
+
+          bool written = false;
+          try {
+            written = cv::imwrite(encoding.dst_path.string(), encoding.image);
+          } catch (...) {
+          }
+
+          if (!written) {
+            std::lock_guard lock(error_mutex);
+            status.error = "invalid output";
+          }
+
+          if (remaining->fetch_sub(1, std::memory_order_acq_rel) == 1) {
+            finish(status, start);
+          }
+        });
+      }
+    });
+  }
+
+  WaitForInFlight(pool, *in_flight, 0);
+}
+
+#ifdef DOC_COLOR_DECOMPOSER_APP_SOCKETS
+
+const std::size_t kMaxMessageBytes = 1 << 16;
+const std::size_t kLatencyWindow = 1024;
+const std::size_t kMaxIdleWorkspaces = 2;
+const int kPollTimeoutMs = 1000;
+const auto kReceiveTimeout = std::chrono::seconds(5);
+
+struct Job {
+  int fd = -1;
+  std::chrono::steady_clock::time_point accepted;
+  Status status;
+  std::filesystem::path dst_path;
+  Options options;
+};
+
+struct Connection {
+  std::chrono::steady_clock::time_point accepted;
+  std::string message;
+};
+
+struct ServerMetrics {
+  std::mutex mutex;
+  int completed = 0;
+  int failed = 0;
+  std::deque<double> latencies;
+};
+
+std::string ReceiveMessage(int fd) {
+  std::string message;
+  std::array<char, 4096> buffer;
+
+  while (message.size() < kMaxMessageBytes) {
+    ssize_t received = recv(fd, buffer.data(), buffer.size(), 0);
+    if (received <= 0) {
+      break;
+    }
+    message.append(buffer.data(), received);
+  }
+
+  return message;
+}
+
+void SendMessage(int fd, const std::string& message) {
+  for (std::size_t sent = 0; sent < message.size();) {
+    ssize_t written = send(fd, message.data() + sent, message.size() - sent, 0);
+    if (written <= 0) {
+      return;
+    }
+    sent += written;
+  }
+}
+
+std::string WriteMessage(const std::function<void(cv::FileStorage&)>& write) {
+  cv::FileStorage message(".json", cv::FileStorage::WRITE | cv::FileStorage::MEMORY | cv::FileStorage::FORMAT_JSON);
+  write(message);
+
+  return message.releaseAndGetString();
+}
+
+void Reply(int fd, const std::function<void(cv::FileStorage&)>& write) {
+  SendMessage(fd, WriteMessage(write));
+  close(fd);
+}
+
+Job ParseJob(const cv::FileStorage& request, const Options& options) {
+  Job job{.options = options};
+
+  cv::FileNode src = request["src"];
+  cv::FileNode dst = request["dst"];
+  if (!src.isString() || !dst.isString()) {
+    throw std::runtime_error("invalid job");
+  }
+  job.status.src_path = static_cast<std::string>(src);
+  job.dst_path = static_cast<std::string>(dst);
+
+  if (!request["tolerance"].empty()) {
+    int tolerance = static_cast<int>(request["tolerance"]);
+    if (tolerance <= 0 || tolerance % 2 == 0) {
+      throw std::runtime_error("invalid job");
+    }
+    job.options.tolerance = tolerance;
+  }
+  if (!request["masking"].empty()) {
+    job.options.masking = static_cast<int>(request["masking"]) != 0;
+  }
+  if (!request["visualize"].empty()) {
+    job.options.visualize = static_cast<int>(request["visualize"]) != 0;
+    if (job.options.visualize && (options.cluster_model || options.pyramid > 0)) {
+      throw std::runtime_error("invalid job");
+    }
+  }
+
+  return job;
+}
+
+void RunJob(Job& job, ServerMetrics& metrics, WorkspacePool& workspaces) {
+  Status& status = job.status;
+
+  try {
+    std::filesystem::create_directories(job.dst_path);
+  } catch (...) {
+    status.error = "invalid output directory";
+  }
+
+  if (status.error.empty()) {
+    try {
+      Document document = DecodeDocument(0, status, job.options);
+      for (const auto& encoding : DecomposeDocument(document, status, job.dst_path, job.options, workspaces)) {
+        bool written = false;
+        try {
+          written = cv::imwrite(encoding.dst_path.string(), encoding.image);
+        } catch (...) {
+        }
+
+        if (!written) {
+          status.error = "invalid output";
+        }
+      }
+      status.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - document.start).count();
+
+    } catch (const std::exception& e) {
+      status.error = e.what();
+    } catch (...) {
+      status.error = "unknown error";
+    }
+  }
+
+  double latency = std::chrono::duration<double>(std::chrono::steady_clock::now() - job.accepted).count();
+  {
+    std::lock_guard lock(metrics.mutex);
+    if (status.error.empty()) {
+      ++metrics.completed;
+    } else {
+      ++metrics.failed;
+    }
+    metrics.latencies.push_back(latency);
+    if (metrics.latencies.size() > kLatencyWindow) {
+      metrics.latencies.pop_front();
+    }
+  }
+
+  Reply(job.fd, [&](cv::FileStorage& response) {
+    response << "status" << (status.error.empty() ? "ok" : "failed");
+    response << "error" << status.error;
+    response << "layers" << status.stats.clusters;
+    response << "seconds" << status.seconds;
+    response << "latency" << latency;
+  });
+}
+
+void ReplyMetrics(int fd, ServerMetrics& metrics, std::size_t queued, int running) {
+  std::vector<double> latencies;
+  int completed;
+  int failed;
+  {
+    std::lock_guard lock(metrics.mutex);
+    latencies.assign(metrics.latencies.begin(), metrics.latencies.end());
+    completed = metrics.completed;
+    failed = metrics.failed;
+  }
+  std::ranges::sort(latencies);
+
+  auto percentile = [&latencies](double p) { return latencies.empty() ? 0.0 : latencies[static_cast<std::size_t>(p * (latencies.size() - 1))]; };
+
+  Reply(fd, [&](cv::FileStorage& response) {
+    response << "queued" << static_cast<int>(queued);
+    response << "running" << running;
+    response << "completed" << completed;
+    response << "failed" << failed;
+    response << "latency_mean" << (latencies.empty() ? 0.0 : std::reduce(latencies.begin(), latencies.end()) / latencies.size());
+    response << "latency_p50" << percentile(0.5);
+    response << "latency_p90" << percentile(0.9);
+    response << "latency_max" << percentile(1.0);
+  });
+}
+
+int Serve(const std::filesystem::path& socket_path, const Options& options) {
+  sockaddr_un address{.sun_family = AF_UNIX};
+  std::string path = socket_path.string();
+  if (path.size() >= sizeof(address.sun_path)) {
+    std::cerr << "Error: invalid socket";
+    return 1;
+  }
+  std::ranges::copy(path, address.sun_path);
+
+  int listen_fd = socket(AF_UNIX, SOCK_STREAM, 0);
+  unlink(path.c_str());
+  if (listen_fd < 0 || bind(listen_fd, reinterpret_cast<sockaddr*>(&address), sizeof(address)) != 0 || listen(listen_fd, SOMAXCONN) != 0) {
+    std::cerr << "Error: invalid socket";
+    return 1;
+  }
+
+  std::signal(SIGPIPE, SIG_IGN);
+  cv::utils::logging::setLogLevel(cv::utils::logging::LOG_LEVEL_FATAL);
+
+  doc_color_decomposer::ThreadPool pool(options.jobs > 0 ? options.jobs : static_cast<int>(std::thread::hardware_concurrency()));
+  const int kMaxInFlight = 2 * pool.CountThreads();
+
+  BoundedQueue<Job> jobs(options.queue > 0 ? options.queue : kMaxInFlight);
+  ServerMetrics metrics;
+  WorkspacePool workspaces(kMaxIdleWorkspaces);
+  auto in_flight = std::make_shared<std::atomic<int>>(0);
+
+  std::jthread dispatcher([&] {
+    while (auto job = jobs.Pop()) {
+      WaitForInFlight(pool, *in_flight, kMaxInFlight - 1);
+
+      in_flight->fetch_add(1, std::memory_order_relaxed);
+      pool.Submit([&, in_flight, job = std::move(*job)]() mutable {
+        RunJob(job, metrics, workspaces);
+        in_flight->fetch_sub(1, std::memory_order_release);
+        in_flight->notify_one();
+      });
+    }
+
+    WaitForInFlight(pool, *in_flight, 0);
+  });
+
+  std::cout << "Listening on " << path << std::endl;
+
+  auto handle_request = [&](int fd, const std::string& message, std::chrono::steady_clock::time_point accepted) {
+    try {
+      cv::FileStorage request(message, cv::FileStorage::READ | cv::FileStorage::MEMORY | cv::FileStorage::FORMAT_JSON);
+
+      if (!request["metrics"].empty()) {
+        ReplyMetrics(fd, metrics, jobs.Size(), in_flight->load(std::memory_order_relaxed));
+        return;
+      }
+
+      Job job = ParseJob(request, options);
+      job.fd = fd;
+      job.accepted = accepted;
+
+      if (!jobs.TryPush(std::move(job))) {
+        Reply(fd, [](cv::FileStorage& response) { response << "status" << "busy"; });
       }
 
     } catch (...) {
+      Reply(fd, [](cv::FileStorage& response) {
+        response << "status" << "failed";
+        response << "error" << "invalid job";
+      });
+    }
+  };
+
+  std::map<int, Connection> connections;
+  std::vector<pollfd> poll_fds;
+
+  while (true) {
+    poll_fds.assign(1, {.fd = listen_fd, .events = POLLIN});
+    for (const auto& fd : connections | std::views::keys) {
+      poll_fds.push_back({.fd = fd, .events = POLLIN});
+    }
+
+    if (poll(poll_fds.data(), poll_fds.size(), kPollTimeoutMs) < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      break;
+    }
+
+    auto now = std::chrono::steady_clock::now();
+
+    if (poll_fds.front().revents != 0) {
+      int fd = accept(listen_fd, nullptr, nullptr);
+      if (fd >= 0) {
+        connections[fd] = {.accepted = now};
+      }
+    }
+
+    for (const auto& poll_fd : poll_fds | std::views::drop(1)) {
+      if (poll_fd.revents == 0) {
+        continue;
+      }
+
+      Connection& connection = connections[poll_fd.fd];
+      std::array<char, 4096> buffer;
+      ssize_t received = recv(poll_fd.fd, buffer.data(), buffer.size(), 0);
+
+      if (received > 0 && connection.message.size() + received <= kMaxMessageBytes) {
+        connection.message.append(buffer.data(), received);
+        continue;
+      }
+      if (received < 0 && errno == EINTR) {
+        continue;
+      }
+
+      handle_request(poll_fd.fd, received == 0 ? connection.message : std::string(), connection.accepted);
+      connections.erase(poll_fd.fd);
+    }
+
+    std::erase_if(connections, [&now](const auto& fd_connection) {
+      const auto& [fd, connection] = fd_connection;
+      if (now - connection.accepted < kReceiveTimeout) {
+        return false;
+      }
+
+      close(fd);
+      return true;
+    });
+  }
+
+  for (const auto& fd : connections | std::views::keys) {
+    close(fd);
+  }
+  jobs.Close();
+  close(listen_fd);
+  std::cerr << "Error: invalid socket";
+  return 1;
+}
+
+std::optional<std::string> Request(const std::filesystem::path& socket_path, const std::string& message) {
+  sockaddr_un address{.sun_family = AF_UNIX};
+  std::string path = socket_path.string();
+  if (path.size() >= sizeof(address.sun_path)) {
+    return std::nullopt;
+  }
+  std::ranges::copy(path, address.sun_path);
+
+  int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+  if (fd < 0 || connect(fd, reinterpret_cast<sockaddr*>(&address), sizeof(address)) != 0) {
+    if (fd >= 0) {
+      close(fd);
+    }
+    return std::nullopt;
+  }
+
+  SendMessage(fd, message);
+  shutdown(fd, SHUT_WR);
+  std::string response = ReceiveMessage(fd);
+  close(fd);
+
+  return response;
+}
+
+int RunClient(const std::filesystem::path& src_path, const std::filesystem::path& dst_path, const Options& options) {
+  std::string message = WriteMessage([&](cv::FileStorage& request) {
+    request << "src" << std::filesystem::absolute(src_path).string();
+    request << "dst" << std::filesystem::absolute(dst_path).string();
+    request << "tolerance" << options.tolerance;
+    request << "masking" << static_cast<int>(options.masking);
+    request << "visualize" << static_cast<int>(options.visualize);
+  });
+
+  while (true) {
+    std::optional<std::string> response = Request(options.connect, message);
+    if (!response) {
+      std::cerr << "Error: server unavailable";
+      return 1;
+    }
+
+    std::string status;
+    std::string error;
+    try {
+      cv::FileStorage reply(*response, cv::FileStorage::READ | cv::FileStorage::MEMORY | cv::FileStorage::FORMAT_JSON);
+      status = static_cast<std::string>(reply["status"]);
+      error = static_cast<std::string>(reply["error"]);
+    } catch (...) {
+    }
+
+    if (status.empty()) {
+      std::cerr << "Error: invalid response";
+      return 1;
+    }
+
+    if (status == "busy") {
+      std::this_thread::sleep_for(std::chrono::milliseconds(100));
+      continue;
+    }
+    if (status != "ok") {
+      std::cerr << "Error: " << error;
+      return 1;
+    }
+
+    std::cout << "Success: files saved";
+    return 0;
+  }
+}
+
+int PrintMetrics(const std::filesystem::path& socket_path) {
+  std::optional<std::string> response = Request(socket_path, WriteMessage([](cv::FileStorage& request) { request << "metrics" << 1; }));
+  if (!response) {
+    std::cerr << "Error: server unavailable";
+    return 1;
+  }
+
+  std::cout << *response;
+  return 0;
+}
+
+#endif
+
+bool ParseOptions(std::span<const std::string> args, Options& options) {
+  for (const auto& arg : args) {
+    if (std::regex_match(arg, std::regex("^--groundtruth=.+$"))) {
+      options.groundtruth = arg.substr(std::string("--groundtruth=").size());
+    } else if (std::regex_match(arg, std::regex("^--tolerance=[0-9]*[13579]$"))) {
+      options.tolerance = std::stoi(arg.substr(std::string("--tolerance=").size()));
+    } else if (std::regex_match(arg, std::regex("^--strip=[1-9][0-9]*$"))) {
+      options.strip_rows = std::stoi(arg.substr(std::string("--strip=").size()));
+    } else if (std::regex_match(arg, std::regex("^--sample=(0?\\.[0-9]*[1-9][0-9]*|1)$"))) {
+      options.sample_density = std::stod(arg.substr(std::string("--sample=").size()));
+      if (options.sampling == doc_color_decomposer::Sampling::kFull) {
+        options.sampling = doc_color_decomposer::Sampling::kStrided;
+      }
+    } else if (std::regex_match(arg, std::regex("^--sample-mode=(strided|random|pyramid)$"))) {
+      std::string mode = arg.substr(std::string("--sample-mode=").size());
+      options.sampling = mode == "random" ? doc_color_decomposer::Sampling::kRandom : mode == "pyramid" ? doc_color_decomposer::Sampling::kPyramid : doc_color_decomposer::Sampling::kStrided;
+    } else if (std::regex_match(arg, std::regex("^--model=.+$"))) {
+      options.model = arg.substr(std::string("--model=").size());
+    } else if (std::regex_match(arg, std::regex("^--export-model=.+$"))) {
+      options.export_model = arg.substr(std::string("--export-model=").size());
+    } else if (std::regex_match(arg, std::regex("^--pyramid=[248]$"))) {
+      options.pyramid = std::stoi(arg.substr(std::string("--pyramid=").size()));
+    } else if (std::regex_match(arg, std::regex("^--stats=.+$"))) {
+      options.stats = arg.substr(std::string("--stats=").size());
+    } else if (std::regex_match(arg, std::regex("^--trace=.+$"))) {
+      options.trace = arg.substr(std::string("--trace=").size());
+    } else if (std::regex_match(arg, std::regex("^--search-tolerances=[0-9]+(:[0-9]+)?(,[0-9]+(:[0-9]+)?)*$"))) {
+      options.search_tolerances = ParseOddRanges(arg.substr(std::string("--search-tolerances=").size()));
+    } else if (std::regex_match(arg, std::regex("^--search-peak-factors=[0-9.]+(,[0-9.]+)*$"))) {
+      options.search_peak_factors = ParseList(arg.substr(std::string("--search-peak-factors=").size()));
+    } else if (std::regex_match(arg, std::regex("^--search-saturations=[0-9.]+(,[0-9.]+)*$"))) {
+      options.search_saturation_threshs = ParseList(arg.substr(std::string("--search-saturations=").size()));
+    } else if (std::regex_match(arg, std::regex("^--search-lightnesses=[0-9.]+(,[0-9.]+)*$"))) {
+      options.search_lightness_threshs = ParseList(arg.substr(std::string("--search-lightnesses=").size()));
+    } else if (std::regex_match(arg, std::regex("^--jobs=[1-9][0-9]*$"))) {
+      options.jobs = std::stoi(arg.substr(std::string("--jobs=").size()));
+    } else if (std::regex_match(arg, std::regex("^--threads=[1-9][0-9]*$"))) {
+      options.threads = std::stoi(arg.substr(std::string("--threads=").size()));
+    } else if (std::regex_match(arg, std::regex("^--queue=[1-9][0-9]*$"))) {
+      options.queue = std::stoi(arg.substr(std::string("--queue=").size()));
+    } else if (std::regex_match(arg, std::regex("^--connect=.+$"))) {
+      options.connect = arg.substr(std::string("--connect=").size());
+
+    } else if (arg == "--nopreprocess") {
+      options.nopreprocess = true;
+    } else if (arg == "--vectorize") {
+      options.vectorize = true;
+    } else if (arg == "--masking") {
+      options.masking = true;
+    } else if (arg == "--sparse") {
+      options.sparse = true;
+    } else if (arg == "--labels") {
+      options.labeling = true;
+    } else if (arg == "--container") {
+      options.container = true;
+    } else if (arg == "--visualize") {
+      options.visualize = true;
+    } else if (arg == "--drift") {
+      options.drift = true;
+    } else if (arg == "--search") {
+      options.search = true;
+
+    } else {
+      return false;
+    }
+  }
+
+  return !options.visualize || (options.model.empty() && options.pyramid == 0);
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+  std::vector<std::string> args(argv + 1, argv + argc);
+
+#ifdef DOC_COLOR_DECOMPOSER_APP_SOCKETS
+  if (!args.empty() && std::regex_match(args[0], std::regex("^--serve=.+$"))) {
+    Options options;
+    if (!ParseOptions(std::span(args).subspan(1), options)) {
       std::cerr << "Error: invalid arguments\n";
       std::cerr << "Checkout `./doc-color-decomposer --help`";
       return 1;
     }
 
-    cv::utils::logging::setLogLevel(cv::utils::logging::LOG_LEVEL_FATAL);
+    if (!LoadModel(options)) {
+      std::cerr << "Error: invalid model";
+      return 1;
+    }
 
-    doc_color_decomposer::DocColorDecomposer dcd;
-    try {
-      cv::Mat src = cv::imread(src_path.string(), cv::IMREAD_COLOR);
-      dcd = doc_color_decomposer::DocColorDecomposer(src, tolerance, !nopreprocess);
+    return Serve(args[0].substr(std::string("--serve=").size()), options);
+  }
 
-    } catch (...) {
-      std::cerr << "Error: invalid image";
+  if (args.size() == 1 && std::regex_match(args[0], std::regex("^--metrics=.+$"))) {
+    return PrintMetrics(args[0].substr(std::string("--metrics=").size()));
+  }
+#endif
+
+  if (args.size() >= 2) {
+    std::filesystem::path src_path = args[0];
+    std::filesystem::path dst_path = args[1];
+
+    Options options;
+    if (!ParseOptions(std::span(args).subspan(2), options)) {
+      std::cerr << "Error: invalid arguments\n";
+      std::cerr << "Checkout `./doc-color-decomposer --help`";
+      return 1;
+    }
+
+    if (!options.connect.empty()) {
+#ifdef DOC_COLOR_DECOMPOSER_APP_SOCKETS
+      return RunClient(src_path, dst_path, options);
+#else
+      std::cerr << "Error: invalid arguments\n";
+      std::cerr << "Checkout `./doc-color-decomposer --help`";
       return 1;
+#endif
     }
 
+    bool batch = std::filesystem::is_directory(src_path) || src_path.filename().string().find_first_of("*?") != std::string::npos ||
+                 src_path.extension() == ".txt" || src_path.extension() == ".lst";
+
     try {
       if (!std::filesystem::exists(dst_path) || !std::filesystem::is_directory(dst_path)) {
         std::filesystem::create_directory(dst_path);
@@ -77,34 +1090,172 @@ int main(int argc, char** argv) {
       return 1;
     }
 
-    try {
-      if (!groundtruth.empty()) {
-        std::vector<cv::Mat> truth_masks;
-        for (const auto& truth_mask_file : std::filesystem::directory_iterator(groundtruth)) {
-          truth_masks.push_back(cv::imread(truth_mask_file.path().string(), cv::IMREAD_GRAYSCALE));
-        }
+    cv::utils::logging::setLogLevel(cv::utils::logging::LOG_LEVEL_FATAL);
+
+    if (!options.trace.empty()) {
+      doc_color_decomposer::StartTracing();
+    }
+
+    doc_color_decomposer::ThreadPool pool(options.jobs > 0 ? options.jobs : static_cast<int>(std::thread::hardware_concurrency()));
 
-        std::ofstream(dst_path / (src_path.stem().string() + "-quality.txt")) << dcd.ComputeQuality(truth_masks);
+    if (!LoadModel(options)) {
+      std::cerr << "Error: invalid model";
+      return 1;
+    }
+
+    if (!batch) {
+      std::vector<Status> statuses = {{.src_path = src_path, .groundtruth = options.groundtruth}};
+      RunPipeline(statuses, dst_path, options, pool);
+
+      if (!statuses.front().error.empty()) {
+        std::cerr << "Error: " << statuses.front().error;
+        return 1;
+      }
+
+      if (!options.stats.empty()) {
+        std::ofstream stats_file(options.stats);
+        WriteStats(stats_file, statuses.front().stats);
+      }
+      if (!options.trace.empty()) {
+        std::ofstream trace_file(options.trace);
+        doc_color_decomposer::StopTracing(trace_file);
+      }
+
+      std::cout << "Success: files saved";
+      return 0;
+    }
+
+    std::vector<Status> statuses;
+    try {
+      for (const auto& path : CollectImages(src_path)) {
+        statuses.push_back({.src_path = path, .groundtruth = options.groundtruth.empty() ? "" : FindGroundtruth(options.groundtruth, path)});
       }
 
     } catch (...) {
-      std::cerr << "Error: invalid masks";
+      std::cerr << "Error: invalid arguments\n";
+      std::cerr << "Checkout `./doc-color-decomposer --help`";
       return 1;
     }
 
-    for (const auto& [layer_idx, layer] : (masking ? dcd.GetMasks() : dcd.GetLayers()) | std::views::enumerate) {
-      cv::imwrite((dst_path / (src_path.stem().string() + "-layer-")).string() + std::to_string(layer_idx + 1) + ".png", layer);
+    if (options.search) {
+      if (options.groundtruth.empty() || options.search_tolerances.empty()) {
+        std::cerr << "Error: invalid arguments\n";
+        std::cerr << "Checkout `./doc-color-decomposer --help`";
+        return 1;
+      }
+
+      doc_color_decomposer::SearchGrid grid;
+      grid.tolerances = options.search_tolerances;
+      grid.peak_factors = options.search_peak_factors;
+      grid.thresholds.clear();
+      for (const auto& [saturation_thresh, lightness_thresh] : std::views::cartesian_product(options.search_saturation_threshs, options.search_lightness_threshs)) {
+        grid.thresholds.emplace_back(saturation_thresh, lightness_thresh);
+      }
+      grid.preprocessing = !options.nopreprocess;
+      grid.engine = options.vectorize ? doc_color_decomposer::Engine::kVectorized : doc_color_decomposer::Engine::kReference;
+
+      std::vector<doc_color_decomposer::SearchResult> results;
+      try {
+        results = doc_color_decomposer::SearchParams(statuses.size(), [&](std::size_t sample_idx) {
+          const auto& sample_path = statuses[sample_idx].src_path;
+
+          doc_color_decomposer::SearchSample sample;
+          sample.src = cv::imread(sample_path.string(), cv::IMREAD_COLOR);
+          std::filesystem::path groundtruth = FindGroundtruth(options.groundtruth, sample_path);
+          if (std::filesystem::is_regular_file(groundtruth)) {
+            sample.truth_labels = cv::imread(groundtruth.string(), cv::IMREAD_GRAYSCALE);
+          } else {
+            for (const auto& truth_mask_file : std::filesystem::directory_iterator(groundtruth)) {
+              sample.truth_masks.push_back(cv::imread(truth_mask_file.path().string(), cv::IMREAD_GRAYSCALE));
+            }
+          }
+
+          return sample;
+        }, grid, pool);
+
+      } catch (...) {
+        std::cerr << "Error: invalid images or masks";
+        return 1;
+      }
+
+      std::ofstream search(dst_path / "search.tsv");
+      search << "tolerance\tpeak_factor\tsaturation_thresh\tlightness_thresh\tmean_pq\tp10_pq\tmedian_pq\tp90_pq\n";
+      for (const auto& result : results) {
+        search << result.params.tolerance << '\t' << result.params.peak_factor << '\t' << result.params.saturation_thresh << '\t' << result.params.lightness_thresh << '\t';
+        search << result.mean_pq << '\t' << result.p10_pq << '\t' << result.median_pq << '\t' << result.p90_pq << '\n';
+      }
+
+      if (!results.empty()) {
+        const auto& best = results.front().params;
+        std::cout << "Success: best mean PQ " << results.front().mean_pq << " with --tolerance=" << best.tolerance << " (peak factor " << best.peak_factor;
+        std::cout << ", saturation threshold " << best.saturation_thresh << ", lightness threshold " << best.lightness_thresh << "), see search.tsv";
+      }
+
+      return 0;
     }
 
-    if (visualize) {
-      cv::imwrite((dst_path / (src_path.stem().string() + "-plot-2d-lab.png")).string(), dcd.Plot2DLab());
+    if (!options.export_model.empty()) {
+      if (options.visualize) {
+        std::cerr << "Error: invalid arguments\n";
+        std::cerr << "Checkout `./doc-color-decomposer --help`";
+        return 1;
+      }
 
-      std::ofstream(dst_path / (src_path.stem().string() + "-plot-3d-rgb.tex")) << dcd.Plot3DRgb();
-      std::ofstream(dst_path / (src_path.stem().string() + "-plot-1d-phi.tex")) << dcd.Plot1DPhi();
-      std::ofstream(dst_path / (src_path.stem().string() + "-plot-1d-clusters.tex")) << dcd.Plot1DClusters();
+      if (!options.cluster_model) {
+        doc_color_decomposer::Params params = MakeParams(options);
+        params.executor = &pool;
+
+        try {
+          options.cluster_model = doc_color_decomposer::DocColorDecomposer::LearnModel(statuses.size(), [&](std::size_t idx) {
+            return cv::imread(statuses[idx].src_path.string(), cv::IMREAD_COLOR);
+          }, params);
+
+        } catch (...) {
+          std::cerr << "Error: invalid images";
+          return 1;
+        }
+      }
+
+      try {
+        doc_color_decomposer::WriteClusterModel(options.export_model, *options.cluster_model);
+
+      } catch (...) {
+        std::cerr << "Error: invalid model";
+        return 1;
+      }
+      options.export_model.clear();
     }
 
-    std::cout << "Success: files saved";
+    RunPipeline(statuses, dst_path, options, pool);
+
+    std::ofstream summary(dst_path / "summary.tsv");
+    summary << "image\tstatus\tlayers\tseconds\terror\n" << std::fixed << std::setprecision(3);
+    for (const auto& status : statuses) {
+      summary << status.src_path.string() << '\t' << (status.error.empty() ? "ok" : "failed") << '\t' << status.stats.clusters << '\t' << status.seconds << '\t' << status.error << '\n';
+    }
+
+    if (!options.stats.empty()) {
+      std::ofstream stats_file(options.stats);
+      stats_file << "[\n";
+      for (const auto& [idx, status] : statuses | std::views::enumerate) {
+        stats_file << "  {\"image\": " << status.src_path << ", \"stats\": ";
+        WriteStats(stats_file, status.stats);
+        stats_file << (idx + 1 < std::ssize(statuses) ? "},\n" : "}\n");
+      }
+      stats_file << "]\n";
+    }
+    if (!options.trace.empty()) {
+      std::ofstream trace_file(options.trace);
+      doc_color_decomposer::StopTracing(trace_file);
+    }
+
+    auto failed = std::ranges::count_if(statuses, [](const auto& status) { return !status.error.empty(); });
+    if (failed > 0) {
+      std::cerr << "Error: " << failed << " of " << statuses.size() << " documents failed, see summary.tsv";
+      return 1;
+    }
+
+    std::cout << "Success: " << statuses.size() << " documents saved";
 
   } else if (args.empty() || args.size() == 1 && args[0] == "--help") {
     std::cout << "DESCRIPTION\n";
@@ -112,14 +1263,51 @@ int main(int argc, char** argv) {
     std::cout << "  More info: https://github.com/Sh1kar1/doc-color-decomposer\n\n";
 
     std::cout << "SYNOPSIS\n";
-    std::cout << "  ./doc-color-decomposer <path-to-image> <path-to-output-directory> [options]\n\n";
+    std::cout << "  ./doc-color-decomposer <path-to-image> <path-to-output-directory> [options]\n";
+    std::cout << "  ./doc-color-decomposer <path-to-directory|glob|manifest.txt> <path-to-output-directory> [options]\n";
+    std::cout << "  ./doc-color-decomposer --serve=<path-to-socket> [options]\n";
+    std::cout << "  ./doc-color-decomposer --metrics=<path-to-socket>\n\n";
 
     std::cout << "OPTIONS\n";
-    std::cout << "  --groundtruth=<path-to-directory-with-masks>  Set path to truth image masks and compute quality\n";
+    std::cout << "  --groundtruth=<path-to-masks-or-labels>       Set path to a directory with truth image masks or to a truth label image and compute quality\n";
+    std::cout << "                                                (in batch mode: to a directory with a subdirectory of masks or a <stem>.png label image per image)\n";
     std::cout << "  --tolerance=<odd-positive-value>              Set tolerance of decomposition (default: 35)\n";
+    std::cout << "  --strip=<positive-value>                      Decompose a PPM image by strips of the given height and save PPM/PGM layers\n";
+    std::cout << "  --sample=<density-between-0-and-1>            Build the histogram from a fraction of the pixels (default mode: strided)\n";
+    std::cout << "  --sample-mode=<strided|random|pyramid>        Set how the pixels of the histogram are sampled\n";
+    std::cout << "  --model=<path-to-model>                       Decompose with the clusters of a model instead of clustering every image\n";
+    std::cout << "  --export-model=<path-to-model>                Save the clusters as a .yml/.json model (in batch mode: learned from the pooled colors of all images)\n";
+    std::cout << "  --pyramid=<2|4|8>                             Cluster a reduced copy (JPEG: decoded at the reduced scale) and label the unsmoothed full one with its clusters\n";
+    std::cout << "  --drift                                       Save drift of the sampled or reduced clusters from the exact ones\n";
+    std::cout << "  --stats=<path-to-json>                        Save stage timings and counters of decomposition\n";
+    std::cout << "  --trace=<path-to-json>                        Save stages and parallel stripes as Chrome trace events\n";
+    std::cout << "  --search                                      Search the parameters maximizing quality over a batch with ground truth\n";
+    std::cout << "  --search-tolerances=<odd-value|from:to,...>   Set tolerances to search (default: 35)\n";
+    std::cout << "  --search-peak-factors=<value,...>             Set minimum relative heights of the peaks to search (default: 0.025)\n";
+    std::cout << "  --search-saturations=<value,...>              Set saturation thresholds of preprocessing to search (default: 10)\n";
+    std::cout << "  --search-lightnesses=<value,...>              Set lightness thresholds of preprocessing to search (default: 50)\n";
+    std::cout << "  --jobs=<positive-value>                       Set number of threads (default: number of cores)\n";
+    std::cout << "  --threads=<positive-value>                    Limit number of threads decomposing a single image (default: all threads)\n";
+    std::cout << "  --queue=<positive-value>                      Set number of jobs a server queues before answering busy (default: twice the threads)\n";
+    std::cout << "  --connect=<path-to-socket>                    Send the image with the tolerance, masking and visualize options to a server instead\n";
     std::cout << "  --nopreprocess                                Disable image preprocessing by aberration reduction\n";
+    std::cout << "  --vectorize                                   Project colors with the vectorized engine\n";
     std::cout << "  --masking                                     Save binary masks instead of layers\n";
-    std::cout << "  --visualize                                   Save visualizations";
+    std::cout << "  --sparse                                      Save run-length encoded masks of all layers in a single file instead of layers\n";
+    std::cout << "  --labels                                      Save a label image and its palette instead of layers\n";
+    std::cout << "  --container                                   Save all layers with their palette and phi ranges in a single .dcd container\n";
+    std::cout << "  --visualize                                   Save visualizations (not with --model, --pyramid or a batch --export-model)\n\n";
+
+    std::cout << "BATCH MODE\n";
+    std::cout << "  A directory, a glob over file names or a manifest (.txt/.lst with one path per line) decomposes every image in parallel\n";
+    std::cout << "  while the next images are decoded and the layers of the previous ones are encoded\n";
+    std::cout << "  and writes the status and the timing of each image to summary.tsv in the output directory\n\n";
+
+    std::cout << "SERVER MODE\n";
+    std::cout << "  A server decomposes the jobs sent to a Unix domain socket on a shared pool of threads with the other options as defaults\n";
+    std::cout << "  Each connection sends a JSON job {\"src\": <path>, \"dst\": <path>, \"tolerance\": <value>, \"masking\": 0|1, \"visualize\": 0|1}\n";
+    std::cout << "  and receives {\"status\": \"ok\"|\"failed\"|\"busy\", \"error\", \"layers\", \"seconds\", \"latency\"} once the job is done\n";
+    std::cout << "  A job {\"metrics\": 1} receives the queue depth, the running jobs, the counters and the latencies of the last jobs";
 
   } else {
     std::cerr << "Error: invalid arguments\n";
@@ -0,0 +1,397 @@
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <iterator>
+#include <map>
+#include <ranges>
+#include <regex>
+#include <sstream>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <opencv2/core/utils/logger.hpp>
+#include <opencv2/imgcodecs/imgcodecs.hpp>
+#include <opencv2/imgproc/imgproc.hpp>
+
+#include "doc_color_decomposer/doc_color_decomposer.h"
+#include "phi_kernel.h"
+#include "utils.h"
+
+namespace doc_color_decomposer {
+
+class StageBenchmark final {
+ public:
+  explicit StageBenchmark(const cv::Mat& src, Engine engine) : src_(src), engine_(engine) {}
+
+  void SetEngine(Engine engine) {
+    engine_ = engine;
+  }
+
+  void Preprocess() {
+    processed_src_ = doc_color_decomposer::Preprocess(src_);
+  }
+
+  void ColorToN() {
+    rgb_to_n_ = doc_color_decomposer::ColorToN(processed_src_);
+  }
+
+  void ComputePhiHistogram() {
+    rgb_to_lab_.assign(rgb_to_n_.size(), {0, 0, 0});
+    rgb_to_phi_.assign(rgb_to_n_.size(), -1);
+
+    if (engine_ == Engine::kVectorized) {
+      std::vector<cv::Vec3b> bgr;
+      bgr.reserve(rgb_to_n_.size());
+      std::ranges::transform(rgb_to_n_ | std::views::keys, std::back_inserter(bgr), [](const auto& rgb) { return cv::Vec3b(rgb[2], rgb[1], rgb[0]); });
+
+      ParallelFor(cv::Range(0, static_cast<int>(bgr.size())), [&](const cv::Range& range) {
+        ComputeLabPhi(bgr.data() + range.start, range.size(), rgb_to_lab_.data() + range.start, rgb_to_phi_.data() + range.start);
+      });
+
+    } else {
+      ParallelFor(cv::Range(0, static_cast<int>(rgb_to_n_.size())), [&](const cv::Range& range) {
+        for (const auto& i : std::views::iota(range.start, range.end)) {
+          ProjColorOnLab(rgb_to_n_[i].first, rgb_to_lab_[i], rgb_to_phi_[i]);
+        }
+      });
+    }
+
+    phi_histogram_ = cv::Mat::zeros(1, 360, CV_64FC1);
+    for (const auto& [rgb_n, phi] : std::views::zip(rgb_to_n_, rgb_to_phi_)) {
+      if (phi != -1) {
+        phi_histogram_.at<double>(phi) += rgb_n.second;
+      }
+    }
+  }
+
+  void ComputeClusters() {
+    Params params;
+    clusters_ = FindClusters(SmoothHistogram(phi_histogram_, params.tolerance), params.peak_factor);
+    phi_to_cluster_ = MapPhiToCluster(clusters_);
+  }
+
+  void ComputeLabels() {
+    rgb_to_cluster_.assign(1 << 24, 0);
+    for (const auto& [rgb, phi] : std::views::zip(rgb_to_n_ | std::views::keys, rgb_to_phi_)) {
+      rgb_to_cluster_[rgb[0] << 16 | rgb[1] << 8 | rgb[2]] = static_cast<uchar>(phi == -1 ? 0 : phi_to_cluster_[phi]);
+    }
+
+    ColorToLabel(processed_src_, labels_, rgb_to_cluster_);
+  }
+
+  void GetLayers() {
+    layers_ = LabelToLayers(src_, labels_, static_cast<int>(clusters_.size()) + 1);
+  }
+
+  [[nodiscard]] int CountColors() const {
+    return static_cast<int>(rgb_to_n_.size());
+  }
+
+ private:
+  cv::Mat src_;
+  cv::Mat processed_src_;
+  Engine engine_;
+  std::vector<std::pair<std::array<int, 3>, int>> rgb_to_n_;
+  std::vector<std::array<int, 3>> rgb_to_lab_;
+  std::vector<int> rgb_to_phi_;
+  cv::Mat phi_histogram_;
+  std::vector<int> clusters_;
+  std::vector<int> phi_to_cluster_;
+  std::vector<uchar> rgb_to_cluster_;
+  cv::Mat labels_;
+  std::vector<cv::Mat> layers_;
+};
+
+}  // namespace doc_color_decomposer
+
+namespace {
+
+struct Measurement {
+  std::string name;
+  std::string document;
+  std::string stage;
+  int pixels = 0;
+  int colors = 0;
+  double median_ms = 0.0;
+  double min_ms = 0.0;
+};
+
+struct Document {
+  std::string name;
+  cv::Mat src;
+};
+
+cv::Mat MakeDocument(cv::Size size, int noise, int inks, int seed) {
+  cv::RNG rng(seed);
+  cv::Mat document(size, CV_8UC3, cv::Scalar(245, 245, 245));
+
+  std::vector<cv::Scalar> ink_colors;
+  for (const auto& ink_idx : std::views::iota(0, inks)) {
+    cv::Mat ink(1, 1, CV_8UC3, cv::Scalar(180 * ink_idx / inks, 200, 150));
+    cv::cvtColor(ink, ink, cv::COLOR_HSV2BGR);
+    ink_colors.emplace_back(ink.at<cv::Vec3b>(0, 0));
+  }
+
+  int line_height = std::max(size.height / 60, 8);
+  int thickness = std::max(line_height / 12, 1);
+  double font_scale = line_height / 30.0;
+
+  for (const auto& y : std::views::iota(2 * line_height, size.height - line_height) | std::views::stride(3 * line_height / 2)) {
+    std::string line;
+    for (const auto& _ : std::views::iota(0, size.width / line_height)) {
+      line += rng.uniform(0, 6) == 0 ? ' ' : static_cast<char>('a' + rng.uniform(0, 26));
+    }
+
+    cv::putText(document, line, cv::Point(line_height, y), cv::FONT_HERSHEY_SIMPLEX, font_scale, ink_colors[rng.uniform(0, inks)], thickness, cv::LINE_AA);
+  }
+
+  cv::Mat noisy_document;
+  cv::Mat pixel_noise(size, CV_16SC3);
+  rng.fill(pixel_noise, cv::RNG::UNIFORM, -noise, noise + 1);
+  document.convertTo(noisy_document, CV_16SC3);
+  noisy_document += pixel_noise;
+  noisy_document.convertTo(document, CV_8UC3);
+
+  return document;
+}
+
+std::vector<Document> CollectDocuments(const std::filesystem::path& samples_path, const std::regex& filter) {
+  std::vector<Document> documents;
+
+  for (const auto& [size_idx, size] : std::vector<cv::Size>{{620, 877}, {1240, 1754}, {2480, 3508}} | std::views::enumerate) {
+    for (const auto& noise : {2, 12}) {
+      for (const auto& inks : {2, 5, 8}) {
+        std::string name = "synthetic-" + std::to_string(size.width) + "x" + std::to_string(size.height) + "-noise" + std::to_string(noise) + "-inks" + std::to_string(inks);
+        if (std::regex_search(name, filter)) {
+          documents.push_back({name, MakeDocument(size, noise, inks, static_cast<int>(size_idx) * 100 + noise * 10 + inks)});
+        }
+      }
+    }
+  }
+
+  if (std::filesystem::is_directory(samples_path)) {
+    std::vector<std::filesystem::path> sample_paths;
+    for (const auto& file : std::filesystem::directory_iterator(samples_path)) {
+      if (file.is_regular_file() && cv::haveImageReader(file.path().string())) {
+        sample_paths.push_back(file.path());
+      }
+    }
+    std::ranges::sort(sample_paths);
+
+    for (const auto& sample_path : sample_paths) {
+      std::string name = "sample-" + sample_path.stem().string();
+      if (std::regex_search(name, filter)) {
+        documents.push_back({name, cv::imread(sample_path.string(), cv::IMREAD_COLOR)});
+      }
+    }
+  }
+
+  return documents;
+}
+
+std::pair<double, double> Measure(int iterations, const std::function<void()>& run) {
+  run();
+
+  std::vector<double> ms;
+  for (const auto& _ : std::views::iota(0, iterations)) {
+    auto start = std::chrono::steady_clock::now();
+    run();
+    ms.push_back(std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count());
+  }
+  std::ranges::sort(ms);
+
+  return {ms[ms.size() / 2], ms.front()};
+}
+
+std::vector<Measurement> MeasureDocument(const Document& document, int iterations) {
+  using doc_color_decomposer::Engine;
+  using doc_color_decomposer::Sampling;
+
+  std::vector<Measurement> measurements;
+  doc_color_decomposer::StageBenchmark benchmark(document.src, Engine::kReference);
+
+  auto add = [&](const std::string& stage, const std::function<void()>& run) {
+    auto [median_ms, min_ms] = Measure(iterations, run);
+    measurements.push_back({document.name + "/" + stage, document.name, stage, static_cast<int>(document.src.total()), 0, median_ms, min_ms});
+  };
+
+  add("Preprocess", [&] { benchmark.Preprocess(); });
+  add("ColorToN", [&] { benchmark.ColorToN(); });
+
+  benchmark.SetEngine(Engine::kVectorized);
+  add("ComputePhiHistogram/vectorized", [&] { benchmark.ComputePhiHistogram(); });
+  benchmark.SetEngine(Engine::kReference);
+  add("ComputePhiHistogram/reference", [&] { benchmark.ComputePhiHistogram(); });
+
+  add("ComputeClusters", [&] { benchmark.ComputeClusters(); });
+  add("ComputeLabels", [&] { benchmark.ComputeLabels(); });
+  add("GetLayers", [&] { benchmark.GetLayers(); });
+
+  for (const auto& [engine, engine_name] : {std::pair{Engine::kReference, "reference"}, std::pair{Engine::kVectorized, "vectorized"}}) {
+    add(std::string("Constructor/") + engine_name, [&] { doc_color_decomposer::DocColorDecomposer dcd(document.src, 35, true, engine); });
+  }
+
+  for (const auto& [sampling, sampling_name] : {std::pair{Sampling::kStrided, "strided"}, std::pair{Sampling::kRandom, "random"}, std::pair{Sampling::kPyramid, "pyramid"}}) {
+    doc_color_decomposer::Params params{.engine = Engine::kVectorized, .sampling = sampling, .sample_density = 0.05};
+    add(std::string("Constructor/vectorized-") + sampling_name, [&] { doc_color_decomposer::DocColorDecomposer dcd(document.src, params); });
+  }
+
+  int colors = benchmark.CountColors();
+  for (auto& measurement : measurements) {
+    measurement.colors = colors;
+  }
+
+  return measurements;
+}
+
+std::string EscapeJson(const std::string& str) {
+  std::string escaped;
+  for (const auto& c : str) {
+    if (c == '"' || c == '\\') {
+      escaped += '\\';
+      escaped += c;
+    } else if (static_cast<unsigned char>(c) < 0x20) {
+      std::ostringstream code;
+      code << "\\u" << std::hex << std::setw(4) << std::setfill('0') << static_cast<int>(c);
+      escaped += code.str();
+    } else {
+      escaped += c;
+    }
+  }
+
+  return escaped;
+}
+
+void WriteJson(std::ostream& out, const std::vector<Measurement>& measurements, int iterations) {
+  out << std::fixed << std::setprecision(4);
+  out << "{\n";
+  out << "  \"threads\": " << cv::getNumThreads() << ",\n";
+  out << "  \"iterations\": " << iterations << ",\n";
+  out << "  \"benchmarks\": [\n";
+
+  for (const auto& [idx, measurement] : measurements | std::views::enumerate) {
+    out << "    {";
+    out << "\"name\": \"" << EscapeJson(measurement.name) << "\", ";
+    out << "\"document\": \"" << EscapeJson(measurement.document) << "\", ";
+    out << "\"stage\": \"" << EscapeJson(measurement.stage) << "\", ";
+    out << "\"pixels\": " << measurement.pixels << ", ";
+    out << "\"colors\": " << measurement.colors << ", ";
+    out << "\"median_ms\": " << measurement.median_ms << ", ";
+    out << "\"min_ms\": " << measurement.min_ms;
+    out << (idx + 1 < std::ssize(measurements) ? "},\n" : "}\n");
+  }
+
+  out << "  ]\n";
+  out << "}\n";
+}
+
+int Compare(const std::vector<Measurement>& measurements, const std::filesystem::path& baseline_path, double threshold) {
+  cv::FileStorage baseline(baseline_path.string(), cv::FileStorage::READ | cv::FileStorage::FORMAT_JSON);
+
+  std::map<std::string, double> name_to_median_ms;
+  for (const auto& node : baseline["benchmarks"]) {
+    name_to_median_ms[static_cast<std::string>(node["name"])] = static_cast<double>(node["median_ms"]);
+  }
+
+  int regressions = 0;
+  std::cerr << std::fixed << std::setprecision(2);
+
+  for (const auto& measurement : measurements) {
+    auto it = name_to_median_ms.find(measurement.name);
+    if (it == name_to_median_ms.end()) {
+      std::cerr << "NEW         " << measurement.name << ": " << measurement.median_ms << " ms\n";
+      continue;
+    }
+
+    double change = measurement.median_ms / it->second - 1.0;
+    bool is_regression = change > threshold;
+    regressions += is_regression;
+
+    std::cerr << (is_regression ? "REGRESSION  " : change < -threshold ? "IMPROVEMENT " : "OK          ");
+    std::cerr << measurement.name << ": " << it->second << " -> " << measurement.median_ms << " ms (" << std::showpos << 100.0 * change << std::noshowpos << "%)\n";
+  }
+
+  std::cerr << regressions << " regressions over " << 100.0 * threshold << "% threshold\n";
+
+  return regressions > 0 ? 1 : 0;
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+  std::vector<std::string> args(argv + 1, argv + argc);
+
+  std::filesystem::path out_path = "";
+  std::filesystem::path baseline_path = "";
+  std::filesystem::path samples_path = DOC_COLOR_DECOMPOSER_SAMPLES_DIR;
+  std::regex filter(".*");
+  int iterations = 5;
+  double threshold = 0.1;
+
+  for (const auto& arg : args) {
+    if (std::regex_match(arg, std::regex("^--out=.+$"))) {
+      out_path = arg.substr(std::string("--out=").size());
+    } else if (std::regex_match(arg, std::regex("^--compare=.+$"))) {
+      baseline_path = arg.substr(std::string("--compare=").size());
+    } else if (std::regex_match(arg, std::regex("^--samples=.+$"))) {
+      samples_path = arg.substr(std::string("--samples=").size());
+    } else if (std::regex_match(arg, std::regex("^--filter=.+$"))) {
+      filter = std::regex(arg.substr(std::string("--filter=").size()));
+    } else if (std::regex_match(arg, std::regex("^--iterations=[1-9][0-9]*$"))) {
+      iterations = std::stoi(arg.substr(std::string("--iterations=").size()));
+    } else if (std::regex_match(arg, std::regex("^--threshold=[0-9]+$"))) {
+      threshold = std::stoi(arg.substr(std::string("--threshold=").size())) / 100.0;
+
+    } else if (arg == "--help") {
+      std::cout << "SYNOPSIS\n";
+      std::cout << "  ./doc-color-decomposer-benchmarks [options]\n\n";
+
+      std::cout << "OPTIONS\n";
+      std::cout << "  --out=<path-to-json>          Save results to a file instead of the standard output\n";
+      std::cout << "  --compare=<path-to-json>      Compare results with a saved baseline and fail on regressions\n";
+      std::cout << "  --threshold=<percent>         Set slowdown of the median that counts as a regression (default: 10)\n";
+      std::cout << "  --samples=<path-to-directory> Set directory with sample images (default: bundled data)\n";
+      std::cout << "  --filter=<regex>              Run only documents whose names match the regex\n";
+      std::cout << "  --iterations=<positive-value> Set number of timed runs per stage (default: 5)";
+      return 0;
+
+    } else {
+      std::cerr << "Error: invalid arguments\n";
+      std::cerr << "Checkout `./doc-color-decomposer-benchmarks --help`";
+      return 1;
+    }
+  }
+
+  cv::utils::logging::setLogLevel(cv::utils::logging::LOG_LEVEL_FATAL);
+
+  std::vector<Measurement> measurements;
+  for (const auto& document : CollectDocuments(samples_path, filter)) {
+    std::cerr << "Running " << document.name << '\n';
+    std::ranges::move(MeasureDocument(document, iterations), std::back_inserter(measurements));
+  }
+
+  if (out_path.empty()) {
+    WriteJson(std::cout, measurements, iterations);
+  } else {
+    std::ofstream out(out_path);
+    WriteJson(out, measurements, iterations);
+  }
+
+  if (!baseline_path.empty()) {
+    try {
+      return Compare(measurements, baseline_path, threshold);
+
+    } catch (...) {
+      std::cerr << "Error: invalid baseline";
+      return 1;
+    }
+  }
+
+  return 0;
+}
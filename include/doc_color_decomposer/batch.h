@@ -0,0 +1,75 @@
+#ifndef DOC_COLOR_DECOMPOSER_BATCH_H_
+#define DOC_COLOR_DECOMPOSER_BATCH_H_
+
+#include <cstddef>
+#include <exception>
+#include <functional>
+#include <optional>
+#include <vector>
+
+#include <opencv2/core/core.hpp>
+
+#include "doc_color_decomposer/doc_color_decomposer.h"
+#include "doc_color_decomposer/thread_pool.h"
+
+namespace doc_color_decomposer {
+
+/**
+ * @brief Decomposes the images concurrently on the pool
+ *
+ * @details Every image is a task of the pool and the row-parallel stages of its decomposition are split into tasks of the same pool,
+ * so the idle workers steal the row blocks of a large image instead of waiting for it
+ *
+ * @param[in] srcs images in the sRGB format
+ * @param[in] pool pool to run the decompositions on
+ * @param[in] tolerance odd positive value with an increase of which the number of layers decreases
+ * @param[in] preprocessing true if the source images need to be processed by aberration reduction
+ * @param[in] engine engine of the colors projection used to compute the histogram
+ *
+ * @return decompositions in the order of the images
+ */
+[[nodiscard]] std::vector<DocColorDecomposer> DecomposeBatch(const std::vector<cv::Mat>& srcs, ThreadPool& pool, int tolerance = 35, bool preprocessing = true, Engine engine = Engine::kReference);
+
+/**
+ * @brief Decomposes the images concurrently on the pool with the given parameters
+ *
+ * @param[in] srcs images in the sRGB format
+ * @param[in] pool pool to run the decompositions on
+ * @param[in] params parameters of the decompositions
+ *
+ * @return decompositions in the order of the images
+ */
+[[nodiscard]] std::vector<DocColorDecomposer> DecomposeBatch(const std::vector<cv::Mat>& srcs, ThreadPool& pool, const Params& params);
+
+/**
+ * @brief Decomposes the images of a producer concurrently on the pool and reports each decomposition as soon as it is done
+ *
+ * @details The producer is called on the calling thread until it returns no image, at most two images per worker are decomposed at once
+ * and the completion callbacks are called one at a time in the order of the completion
+ *
+ * @param[in] produce function that returns the next image in the sRGB format or std::nullopt after the last image
+ * @param[in] on_complete function that receives the index of an image, its decomposition and the exception thrown while decomposing it if any
+ * @param[in] pool pool to run the decompositions on
+ * @param[in] tolerance odd positive value with an increase of which the number of layers decreases
+ * @param[in] preprocessing true if the source images need to be processed by aberration reduction
+ * @param[in] engine engine of the colors projection used to compute the histogram
+ */
+void DecomposeBatch(const std::function<std::optional<cv::Mat>()>& produce,
+                    const std::function<void(std::size_t, DocColorDecomposer&&, std::exception_ptr)>& on_complete,
+                    ThreadPool& pool, int tolerance = 35, bool preprocessing = true, Engine engine = Engine::kReference);
+
+/**
+ * @brief Decomposes the images of a producer concurrently on the pool with the given parameters and reports each decomposition as soon as it is done
+ *
+ * @param[in] produce function that returns the next image in the sRGB format or std::nullopt after the last image
+ * @param[in] on_complete function that receives the index of an image, its decomposition and the exception thrown while decomposing it if any
+ * @param[in] pool pool to run the decompositions on
+ * @param[in] params parameters of the decompositions
+ */
+void DecomposeBatch(const std::function<std::optional<cv::Mat>()>& produce,
+                    const std::function<void(std::size_t, DocColorDecomposer&&, std::exception_ptr)>& on_complete,
+                    ThreadPool& pool, const Params& params);
+
+}  // namespace doc_color_decomposer
+
+#endif  // DOC_COLOR_DECOMPOSER_BATCH_H_
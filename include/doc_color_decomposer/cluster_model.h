@@ -0,0 +1,40 @@
+#ifndef DOC_COLOR_DECOMPOSER_CLUSTER_MODEL_H_
+#define DOC_COLOR_DECOMPOSER_CLUSTER_MODEL_H_
+
+#include <array>
+#include <filesystem>
+#include <vector>
+
+#include "doc_color_decomposer/params.h"
+
+namespace doc_color_decomposer {
+
+/**
+ * @brief Learned clustering of the colors that labels new documents without computing their histograms
+ */
+struct ClusterModel {
+  Params params;                            ///< parameters the clusters were learned with, the preprocessing ones are applied to the new documents
+  std::vector<int> clusters;                ///< sorted angles in degrees that separate the chromatic layers
+  std::vector<std::array<int, 3>> palette;  ///< mean colors of the layers in the sRGB format indexed by the labels
+};
+
+/**
+ * @brief Serializes a model with cv::FileStorage in the format chosen by the extension of the path
+ *
+ * @param[in] path path to the model with the .yml, .json or .xml extension
+ * @param[in] model model to serialize
+ */
+void WriteClusterModel(const std::filesystem::path& path, const ClusterModel& model);
+
+/**
+ * @brief Deserializes a model written by WriteClusterModel()
+ *
+ * @param[in] path path to the model
+ *
+ * @return deserialized model
+ */
+[[nodiscard]] ClusterModel ReadClusterModel(const std::filesystem::path& path);
+
+}  // namespace doc_color_decomposer
+
+#endif  // DOC_COLOR_DECOMPOSER_CLUSTER_MODEL_H_
@@ -0,0 +1,97 @@
+#ifndef DOC_COLOR_DECOMPOSER_CONTAINER_H_
+#define DOC_COLOR_DECOMPOSER_CONTAINER_H_
+
+#include <array>
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <vector>
+
+#include <opencv2/core/core.hpp>
+
+namespace doc_color_decomposer {
+
+/**
+ * @brief Metadata of a layer stored in a container
+ */
+struct ContainerLayer {
+  int phi_from = -1;                 ///< first angle of the projections of the layer in degrees or -1 for the achromatic layer
+  int phi_to = -1;                   ///< angle after the last one of the layer that is not greater than phi_from if the range wraps around 360
+  std::array<int, 3> mean_rgb = {};  ///< mean color of the layer in the sRGB format
+  cv::Rect box;                      ///< bounding box of the pixels of the layer that is empty if the layer has no pixels
+};
+
+/**
+ * @brief Reader of the containers written by DocColorDecomposer::WriteContainer() that decodes only the requested layers
+ *
+ * @details A container holds the metadata of all the layers followed by an independently compressed PNG chunk per layer
+ * with the colors of its pixels cropped to its bounding box and their coverage in the alpha channel
+ */
+class [[nodiscard]] ContainerReader final {
+ public:
+  /**
+   * @brief Opens a container and parses its metadata
+   *
+   * @param[in] path path to the container
+   */
+  explicit ContainerReader(const std::filesystem::path& path);
+
+  /**
+   * @brief Retrieves the size of the decomposed document
+   *
+   * @return width and height of the document in pixels
+   */
+  [[nodiscard]] cv::Size GetSize() const noexcept;
+
+  /**
+   * @brief Retrieves the number of the stored layers
+   *
+   * @return number of the layers
+   */
+  [[nodiscard]] int CountLayers() const noexcept;
+
+  /**
+   * @brief Retrieves the metadata of the stored layers
+   *
+   * @return list of the metadata of the layers indexed by the labels
+   */
+  [[nodiscard]] const std::vector<ContainerLayer>& GetLayerInfos() const noexcept;
+
+  /**
+   * @brief Decodes a single layer
+   *
+   * @param[in] layer_idx index of the layer
+   *
+   * @return decomposed document layer with a white background in the sRGB format
+   */
+  [[nodiscard]] cv::Mat ReadLayer(int layer_idx);
+
+  /**
+   * @brief Decodes the binary mask of a single layer
+   *
+   * @param[in] layer_idx index of the layer
+   *
+   * @return binary mask of the layer in the grayscale format
+   */
+  [[nodiscard]] cv::Mat ReadMask(int layer_idx);
+
+  /**
+   * @brief Decodes all the layers into a label image
+   *
+   * @return image in the grayscale format where each pixel holds the index of its layer
+   */
+  [[nodiscard]] cv::Mat ReadLabels();
+
+ private:
+  [[nodiscard]] cv::Mat ReadChunk(int layer_idx);
+
+  std::ifstream file_;
+  cv::Size size_;
+  std::vector<ContainerLayer> layers_;
+  std::vector<std::int64_t> chunk_offsets_;
+  std::vector<std::int64_t> chunk_sizes_;
+};
+
+}  // namespace doc_color_decomposer
+
+#endif  // DOC_COLOR_DECOMPOSER_CONTAINER_H_
@@ -2,12 +2,26 @@
 #define DOC_COLOR_DECOMPOSER_H_
 
 #include <array>
-#include <map>
+#include <cstddef>
+#include <filesystem>
+#include <functional>
+#include <memory>
+#include <ostream>
+#include <ranges>
 #include <string>
+#include <utility>
 #include <vector>
 
 #include <opencv2/core/core.hpp>
 
+#include "doc_color_decomposer/cluster_model.h"
+#include "doc_color_decomposer/container.h"
+#include "doc_color_decomposer/image_view.h"
+#include "doc_color_decomposer/params.h"
+#include "doc_color_decomposer/sparse_mask.h"
+#include "doc_color_decomposer/stats.h"
+#include "doc_color_decomposer/strip_io.h"
+
 namespace doc_color_decomposer {
 
 /**
@@ -26,22 +40,322 @@ class [[nodiscard]] DocColorDecomposer final {
    * @param[in] src source image of the document in the sRGB format
    * @param[in] tolerance odd positive value with an increase of which the number of layers decreases
    * @param[in] preprocessing true if the source image needs to be processed by aberration reduction
+   * @param[in] engine engine of the colors projection used to compute the histogram
+   */
+  explicit DocColorDecomposer(const cv::Mat& src, int tolerance = 35, bool preprocessing = true, Engine engine = Engine::kReference);
+
+  /**
+   * @brief Constructs an instance from the given document with the given parameters and precomputes its layers
+   *
+   * @param[in] src source image of the document in the sRGB format
+   * @param[in] params parameters of the decomposition
+   */
+  explicit DocColorDecomposer(const cv::Mat& src, const Params& params);
+
+  /**
+   * @brief Constructs an instance from the given external pixel buffer without copying it and precomputes its layers
+   *
+   * @details The buffer is read in its own channel order and must outlive the instance since the layers are composed from it
+   *
+   * @param[in] view description of the pixel buffer of the document
+   * @param[in] params parameters of the decomposition
+   */
+  explicit DocColorDecomposer(const ImageView& view, const Params& params = Params());
+
+  /**
+   * @brief Constructs an instance from the given document read by strips and computes its clusters without keeping the image in memory
+   *
+   * @details Layers of such an instance are not precomputed and can be written only by WriteLayers()
+   *
+   * @param[in] reader source of the document strips in the sRGB format
+   * @param[in] tolerance odd positive value with an increase of which the number of layers decreases
+   * @param[in] preprocessing true if the source image needs to be processed by aberration reduction
+   * @param[in] engine engine of the colors projection used to compute the histogram
+   * @param[in] strip_rows number of the rows read at once that bounds the memory usage
+   */
+  explicit DocColorDecomposer(StripReader& reader, int tolerance = 35, bool preprocessing = true, Engine engine = Engine::kReference, int strip_rows = 256);
+
+  /**
+   * @brief Constructs an instance from the given document read by strips with the given parameters and computes its clusters
+   *
+   * @param[in] reader source of the document strips in the sRGB format
+   * @param[in] params parameters of the decomposition
+   * @param[in] strip_rows number of the rows read at once that bounds the memory usage
+   */
+  explicit DocColorDecomposer(StripReader& reader, const Params& params, int strip_rows = 256);
+
+  /**
+   * @brief Decomposes the document with the clusters of a model without computing its histogram
+   *
+   * @details The document is preprocessed with the parameters of the model and its colors are mapped to the layers on demand,
+   * so the layer indices stay stable across the documents decomposed by the instance, while the retuning, the scale space and the plots, which need the histogram, throw std::logic_error;
+   * the threads and the executor of the instance are taken from the parameters of the model
+   *
+   * @param[in] src source image of the document in the sRGB format
+   * @param[in] model model learned from other documents
+   */
+  explicit DocColorDecomposer(const cv::Mat& src, const ClusterModel& model);
+
+  /**
+   * @brief Learns a model from the pooled colors of several documents loaded one at a time
+   *
+   * @param[in] pages number of the documents
+   * @param[in] load_page function that loads the source image of a document in the sRGB format by its index or an empty image to skip it
+   * @param[in] params parameters of the decomposition
+   *
+   * @return model with the clusters of the pooled histogram
+   */
+  [[nodiscard]] static ClusterModel LearnModel(std::size_t pages, const std::function<cv::Mat(std::size_t)>& load_page, const Params& params = Params());
+
+  /**
+   * @brief Learns a model from the pooled colors of several documents
+   *
+   * @param[in] srcs source images of the documents in the sRGB format
+   * @param[in] params parameters of the decomposition
+   *
+   * @return model with the clusters of the pooled histogram
+   */
+  [[nodiscard]] static ClusterModel LearnModel(const std::vector<cv::Mat>& srcs, const Params& params = Params());
+
+  /**
+   * @brief Decomposes another document with the parameters of the instance reusing its tables, buffers and temporaries
+   *
+   * @details After the first call the documents of the same size are decomposed without allocating the per-document data,
+   * while the layers, the masks and the labels retrieved before stay valid; an instance constructed from a model only relabels the documents with its clusters
+   *
+   * @param[in] src source image of the document in the sRGB format
+   */
+  void Decompose(const cv::Mat& src) &;
+
+  /**
+   * @brief Decomposes another document from the given external pixel buffer reusing the tables, buffers and temporaries of the instance
+   *
+   * @param[in] view description of the pixel buffer of the document that must outlive its decomposition
+   */
+  void Decompose(const ImageView& view) &;
+
+  /**
+   * @brief Labels another document with the clusters of a model learned from its reduced copy reusing the tables, buffers and temporaries of the instance
+   *
+   * @details Meant for the coarse-to-fine decompositions: the hue smoothing is applied only to the reduced copy by LearnModel(),
+   * while the full-resolution document is not preprocessed and the saturation and lightness thresholds of the model are applied to each of its colors
+   * when the color is first mapped to a layer; the instance keeps the new clusters for the following calls of Decompose(),
+   * and its threads and its executor stay unchanged unless it is empty, in which case they are taken from the model
+   *
+   * @param[in] src source image of the document in the sRGB format
+   * @param[in] model model learned from this or other documents
+   */
+  void Decompose(const cv::Mat& src, const ClusterModel& model) &;
+
+  /**
+   * @brief Decomposes the document read by strips and writes its layers incrementally with the precomputed clusters
+   *
+   * @param[in] reader source of the document strips in the sRGB format
+   * @param[in] make_writer factory of the sinks for the layers by their indices
+   * @param[in] masking true if the binary masks need to be written instead of the layers
+   * @param[in] strip_rows number of the rows read at once that bounds the memory usage
+   */
+  void WriteLayers(StripReader& reader, const std::function<std::unique_ptr<StripWriter>(int)>& make_writer, bool masking = false, int strip_rows = 256) const &;
+
+  /**
+   * @brief Writes the decomposition once into a container with the metadata of the layers and a separately compressed chunk per layer
+   *
+   * @details The chunks hold the layers cropped to their bounding boxes and can be decoded one by one with ContainerReader
+   *
+   * @param[in] path path to the container
+   */
+  void WriteContainer(const std::filesystem::path& path) const &;
+
+  /**
+   * @brief Re-clusters the document with another tolerance reusing its histogram and its color tables
+   *
+   * @details Preprocessing, counting of the colors and their projection are not repeated, so the instance must not be expired by the rvalue accessors;
+   * the label image is recomputed only if the instance holds the document
+   *
+   * @param[in] tolerance odd positive value with an increase of which the number of layers decreases
+   */
+  void Retune(int tolerance) &;
+
+  /**
+   * @brief Re-clusters the document with another tolerance and another peak factor reusing its histogram and its color tables
+   *
+   * @details The precomputed clusters are looked up only if they are computed with the same peak factor
+   *
+   * @param[in] tolerance odd positive value with an increase of which the number of layers decreases
+   * @param[in] peak_factor minimum prominence of a histogram peak relative to the highest one
+   */
+  void Retune(int tolerance, double peak_factor) &;
+
+  /**
+   * @brief Precomputes the smoothed histograms and the clusters for all the odd tolerances up to the given one
+   *
+   * @details Afterwards Retune() with any of these tolerances only looks up its clusters and relabels the document
+   *
+   * @param[in] max_tolerance greatest tolerance of the sweep
+   */
+  void PrecomputeScaleSpace(int max_tolerance = 359) &;
+
+  /**
+   * @brief Precomputes the smoothed histograms and the clusters for the given tolerances with the given peak factor
+   *
+   * @details Only re-clusters the document without relabeling it; the smoothed histograms are kept across the peak factors,
+   * while the clusters computed with another peak factor are discarded
+   *
+   * @param[in] tolerances odd positive tolerances of the sweep
+   * @param[in] peak_factor minimum prominence of a histogram peak relative to the highest one
+   */
+  void PrecomputeScaleSpace(const std::vector<int>& tolerances, double peak_factor) &;
+
+  /**
+   * @brief Compares the clusters of the decomposition with the clusters computed from every pixel of the document
+   *
+   * @details Meant to validate the sample density of an approximate decomposition, since it repeats the exact counting and projection of the colors
+   *
+   * @return numbers of the layers, greatest shift of the cluster boundaries and fraction of the chromatic pixels that change their layer
+   */
+  [[nodiscard]] ClusterDrift MeasureDrift() const &;
+
+  /**
+   * @brief Exports the clusters of the decomposition to be applied to other documents
+   *
+   * @return model with the clusters, the palette and the parameters of the instance
+   */
+  [[nodiscard]] ClusterModel ExportModel() const &;
+
+  /**
+   * @brief Retrieves the current parameters
+   *
+   * @return parameters the clusters are computed with
    */
-  explicit DocColorDecomposer(const cv::Mat& src, int tolerance = 35, bool preprocessing = true);
+  [[nodiscard]] Params GetParams() const & noexcept;
 
   /**
-   * @brief Retrieves the precomputed layers
+   * @brief Retrieves the number of the layers
+   *
+   * @return number of the layers including the achromatic one
+   */
+  [[nodiscard]] int CountLayers() const & noexcept;
+
+  /**
+   * @brief Derives the layers from the precomputed label image
    *
    * @return list of the decomposed document layers with a white background in the sRGB format
    */
-  [[nodiscard]] std::vector<cv::Mat> GetLayers() const & noexcept;
+  [[nodiscard]] std::vector<cv::Mat> GetLayers() const &;
+
+  /**
+   * @brief Derives the layers from the precomputed label image after releasing the intermediate data of the expiring instance
+   *
+   * @return list of the decomposed document layers with a white background in the sRGB format
+   */
+  [[nodiscard]] std::vector<cv::Mat> GetLayers() &&;
+
+  /**
+   * @brief Derives a single layer from the precomputed label image
+   *
+   * @param[in] layer_idx index of the layer
+   *
+   * @return decomposed document layer with a white background in the sRGB format
+   */
+  [[nodiscard]] cv::Mat GetLayer(int layer_idx) const &;
+
+  /**
+   * @brief Derives a single layer from the precomputed label image after releasing the intermediate data of the expiring instance
+   *
+   * @param[in] layer_idx index of the layer
+   *
+   * @return decomposed document layer with a white background in the sRGB format
+   */
+  [[nodiscard]] cv::Mat GetLayer(int layer_idx) &&;
+
+  /**
+   * @brief Creates a lazy view of the layers
+   *
+   * @return range of the layers each of which is derived only when accessed
+   */
+  [[nodiscard]] auto Layers() const & {
+    return std::views::iota(0, CountLayers()) | std::views::transform([this](int layer_idx) { return GetLayer(layer_idx); });
+  }
+
+  void Layers() const && = delete;
 
   /**
-   * @brief Retrieves the precomputed masks of the layers
+   * @brief Derives the masks of the layers from the precomputed label image
    *
    * @return list of the binary masks of the layers in the grayscale format
    */
-  [[nodiscard]] std::vector<cv::Mat> GetMasks() const & noexcept;
+  [[nodiscard]] std::vector<cv::Mat> GetMasks() const &;
+
+  /**
+   * @brief Derives the masks of the layers from the precomputed label image after releasing the intermediate data of the expiring instance
+   *
+   * @return list of the binary masks of the layers in the grayscale format
+   */
+  [[nodiscard]] std::vector<cv::Mat> GetMasks() &&;
+
+  /**
+   * @brief Derives a single mask from the precomputed label image
+   *
+   * @param[in] layer_idx index of the layer
+   *
+   * @return binary mask of the layer in the grayscale format
+   */
+  [[nodiscard]] cv::Mat GetMask(int layer_idx) const &;
+
+  /**
+   * @brief Derives a single mask from the precomputed label image after releasing the intermediate data of the expiring instance
+   *
+   * @param[in] layer_idx index of the layer
+   *
+   * @return binary mask of the layer in the grayscale format
+   */
+  [[nodiscard]] cv::Mat GetMask(int layer_idx) &&;
+
+  /**
+   * @brief Creates a lazy view of the masks of the layers
+   *
+   * @return range of the binary masks each of which is derived only when accessed
+   */
+  [[nodiscard]] auto Masks() const & {
+    return std::views::iota(0, CountLayers()) | std::views::transform([this](int layer_idx) { return GetMask(layer_idx); });
+  }
+
+  void Masks() const && = delete;
+
+  /**
+   * @brief Derives the sparse masks of the layers from the precomputed label image in a single pass
+   *
+   * @return list of the masks of the layers stored as the runs of their rows with their bounding boxes
+   */
+  [[nodiscard]] std::vector<SparseMask> GetSparseMasks() const &;
+
+  /**
+   * @brief Retrieves the precomputed label image
+   *
+   * @return image in the grayscale format where each pixel holds the index of its layer
+   */
+  [[nodiscard]] cv::Mat GetLabels() const & noexcept;
+
+  /**
+   * @brief Moves the precomputed label image out of the expiring instance
+   *
+   * @return image in the grayscale format where each pixel holds the index of its layer
+   */
+  [[nodiscard]] cv::Mat GetLabels() && noexcept;
+
+  /**
+   * @brief Computes the palette of the layers
+   *
+   * @return list of the mean colors of the layers in the sRGB format indexed by the labels
+   */
+  [[nodiscard]] std::vector<std::array<int, 3>> GetPalette() const &;
+
+  /**
+   * @brief Retrieves the timings of the stages of the decomposition and its counters
+   *
+   * @return wall-clock and CPU times of the stages, sizes of the document and of its tables and bytes allocated for the layers and the masks
+   */
+  [[nodiscard]] Stats GetStats() const &;
 
   /**
    * @brief Computes a Panoptic Quality (PQ) of the document decomposition (segmentation)
@@ -52,19 +366,52 @@ class [[nodiscard]] DocColorDecomposer final {
    */
   [[nodiscard]] double ComputeQuality(const std::vector<cv::Mat>& truth_masks) const &;
 
+  /**
+   * @brief Computes a Panoptic Quality (PQ) of the document decomposition (segmentation) against a ground-truth label image
+   *
+   * @param[in] truth_labels ground-truth label image in the grayscale format where each value present marks a segment
+   *
+   * @return value between 0 and 1 that represents a quality
+   */
+  [[nodiscard]] double ComputeQuality(const cv::Mat& truth_labels) const &;
+
+  /**
+   * @brief Computes a Panoptic Quality (PQ) of the document decomposition (segmentation) against sparse ground-truth masks
+   *
+   * @details Only the runs of the masks are visited and the pairs of the masks with disjoint bounding boxes are skipped
+   *
+   * @param[in] truth_masks list of the ground-truth sparse masks
+   *
+   * @return value between 0 and 1 that represents a quality
+   */
+  [[nodiscard]] double ComputeQuality(const std::vector<SparseMask>& truth_masks) const &;
+
   /**
    * @brief Generates a 3D scatter plot of the document colors in the linRGB space
    *
    * @param[in] yaw yaw-rotation angle of the view in degrees
    * @param[in] pitch pitch-rotation angle of the view in degrees
+   * @param[in] seed seed of the sampling of the plotted colors that makes the plot reproducible
    *
    * @return LaTeX code of the plot that can be saved in the .tex format and compiled
    */
-  [[nodiscard]] std::string Plot3DRgb(double yaw = 135.0, double pitch = 35.25) &;
+  [[nodiscard]] std::string Plot3DRgb(double yaw = 135.0, double pitch = 35.25, unsigned seed = 0) &;
+
+  /**
+   * @brief Writes a 3D scatter plot of the document colors in the linRGB space into a sink
+   *
+   * @param[in] out stream that receives the LaTeX code of the plot
+   * @param[in] yaw yaw-rotation angle of the view in degrees
+   * @param[in] pitch pitch-rotation angle of the view in degrees
+   * @param[in] seed seed of the sampling of the plotted colors that makes the plot reproducible
+   */
+  void Plot3DRgb(std::ostream& out, double yaw = 135.0, double pitch = 35.25, unsigned seed = 0) &;
 
   /**
    * @brief Generates a 2D scatter plot of the document colors projections on the \f$\alpha\beta\f$ plane
    *
+   * @details The background of the plot is decoded once per process and shared by all the instances
+   *
    * @return image of the plot in the sRGB format
    */
   [[nodiscard]] cv::Mat Plot2DLab() &;
@@ -76,6 +423,13 @@ class [[nodiscard]] DocColorDecomposer final {
    */
   [[nodiscard]] std::string Plot1DPhi() &;
 
+  /**
+   * @brief Writes a 1D histogram plot with respect to the angle \f$\phi\f$ in polar coordinates into a sink
+   *
+   * @param[in] out stream that receives the LaTeX code of the plot
+   */
+  void Plot1DPhi(std::ostream& out) &;
+
   /**
    * @brief Generates a smoothed and separated by clusters 1D histogram plot
    *
@@ -83,27 +437,68 @@ class [[nodiscard]] DocColorDecomposer final {
    */
   [[nodiscard]] std::string Plot1DClusters() &;
 
+  /**
+   * @brief Writes a smoothed and separated by clusters 1D histogram plot into a sink
+   *
+   * @param[in] out stream that receives the LaTeX code of the plot
+   */
+  void Plot1DClusters(std::ostream& out) &;
+
  private:
+  explicit DocColorDecomposer(const cv::Mat& src, const Params& params, PixelFormat format);
+
+  void ApplyModel(const ClusterModel& model);
+  void DecomposeImage(const cv::Mat& src, PixelFormat format, bool coarse_to_fine = false);
   void ComputePhiHistogram();
   void ComputeSmoothedPhiHistogram();
   void ComputeClusters();
-  void ComputeLayers();
+  void ComputeRgbToCluster();
+  void ComputeLabels();
+  void ReleaseWorkspace() noexcept;
+  void ReleaseIntermediates() noexcept;
+  void RunStage(const char* name, const std::function<void()>& stage);
+  void CountTables() noexcept;
+  void RequireColors() const;
+
+  [[nodiscard]] PixelFormat GetProcessedFormat() const noexcept;
+
+  [[nodiscard]] cv::Mat TrackAllocation(cv::Mat mat) const noexcept;
+  [[nodiscard]] std::vector<cv::Mat> TrackAllocation(std::vector<cv::Mat> mats) const noexcept;
+
+  template <typename OutputIt>
+  OutputIt AppendPlot3DRgb(OutputIt out, double yaw, double pitch, unsigned seed) const;
+  template <typename OutputIt>
+  OutputIt AppendPlot1DPhi(OutputIt out) const;
+  template <typename OutputIt>
+  OutputIt AppendPlot1DClusters(OutputIt out) const;
 
-  [[nodiscard]] std::vector<std::array<int, 3>> PhiToMeanRgb();
-  [[nodiscard]] std::vector<std::array<int, 3>> ClusterToMeanRgb();
+  [[nodiscard]] std::vector<std::array<int, 3>> PhiToMeanRgb() const;
+  [[nodiscard]] std::vector<std::array<int, 3>> ClusterToMeanRgb() const;
 
   cv::Mat src_;
   cv::Mat processed_src_;
-  int tolerance_;
+  PixelFormat format_ = PixelFormat::kBgr;
+  Params params_;
+  bool frozen_clusters_ = false;
+  bool coarse_to_fine_ = false;
+  std::vector<std::array<int, 3>> model_palette_;
   cv::Mat phi_histogram_;
   cv::Mat smoothed_phi_histogram_;
   std::vector<int> clusters_;
-  std::map<std::array<int, 3>, int> rgb_to_n_;
-  std::map<std::array<int, 3>, std::array<int, 3>> rgb_to_lab_;
-  std::map<std::array<int, 3>, int> lab_to_phi_;
+  std::vector<cv::Mat> scale_to_smoothed_phi_histogram_;
+  std::vector<std::vector<int>> scale_to_clusters_;
+  double scale_peak_factor_ = 0.0;
+  std::vector<std::pair<std::array<int, 3>, int>> rgb_to_n_;
+  std::vector<std::array<int, 3>> rgb_to_lab_;
+  std::vector<int> rgb_to_phi_;
   std::vector<int> phi_to_cluster_;
-  std::vector<cv::Mat> masks_;
-  std::vector<cv::Mat> layers_;
+  std::vector<uchar> rgb_to_cluster_;
+  std::vector<int> key_to_n_;
+  std::vector<int> keys_;
+  std::vector<std::vector<std::pair<int, int>>> stripe_to_key_to_n_;
+  cv::Mat labels_;
+  Stats stats_;
+  mutable std::size_t layer_bytes_ = 0;
 };
 
 }  // namespace doc_color_decomposer
@@ -0,0 +1,31 @@
+#ifndef DOC_COLOR_DECOMPOSER_IMAGE_VIEW_H_
+#define DOC_COLOR_DECOMPOSER_IMAGE_VIEW_H_
+
+#include <cstddef>
+
+namespace doc_color_decomposer {
+
+/**
+ * @brief Order of the 8-bit channels of a pixel
+ */
+enum class PixelFormat {
+  kBgr,   ///< blue, green, red
+  kRgb,   ///< red, green, blue
+  kBgra,  ///< blue, green, red, alpha that is ignored
+  kRgba   ///< red, green, blue, alpha that is ignored
+};
+
+/**
+ * @brief Non-owning description of an external pixel buffer
+ */
+struct ImageView {
+  const unsigned char* data = nullptr;     ///< pointer to the first channel of the top-left pixel
+  int width = 0;                           ///< number of the pixels in a row
+  int height = 0;                          ///< number of the rows
+  std::size_t stride = 0;                  ///< number of the bytes between the starts of the consecutive rows or 0 for tightly packed rows
+  PixelFormat format = PixelFormat::kBgr;  ///< order of the channels of the pixels
+};
+
+}  // namespace doc_color_decomposer
+
+#endif  // DOC_COLOR_DECOMPOSER_IMAGE_VIEW_H_
@@ -0,0 +1,49 @@
+#ifndef DOC_COLOR_DECOMPOSER_PARAMS_H_
+#define DOC_COLOR_DECOMPOSER_PARAMS_H_
+
+namespace doc_color_decomposer {
+
+class Executor;
+
+/**
+ * @brief Engine that projects the document colors onto the \f$\alpha\beta\f$ plane
+ */
+enum class Engine {
+  kReference,  ///< per-color projection via OpenCV matrix operations
+  kVectorized  ///< SIMD kernel with a runtime CPU dispatch, bit-identical to the reference
+};
+
+/**
+ * @brief Source of the pixels that build the histogram of the projections of the colors
+ */
+enum class Sampling {
+  kFull,     ///< every pixel of the document
+  kStrided,  ///< every pixel of a regular grid whose density is the sample density
+  kRandom,   ///< pixels drawn by a seeded generator with the probability equal to the sample density
+  kPyramid   ///< pixels of the smallest image pyramid level whose area relative to the document is not below the sample density
+};
+
+/**
+ * @brief Parameters of a decomposition
+ */
+struct Params {
+  int tolerance = 35;                   ///< odd positive value with an increase of which the number of layers decreases
+  bool preprocessing = true;            ///< true if the source image needs to be processed by aberration reduction
+  double saturation_thresh = 10.0;      ///< saturation below which the preprocessing makes a color achromatic
+  double lightness_thresh = 50.0;       ///< lightness below which the preprocessing makes a color black
+  double peak_factor = 0.025;           ///< minimum prominence of a histogram peak relative to the highest one
+  Engine engine = Engine::kReference;   ///< engine of the colors projection used to compute the histogram
+  Sampling sampling = Sampling::kFull;  ///< source of the pixels of the histogram, the layers are always labeled at full resolution
+  double sample_density = 0.05;         ///< fraction of the pixels that build the histogram unless the sampling is full
+  int threads = 0;                      ///< maximum number of the threads of the row-parallel stages or 0 to use all the threads of the executor
+  Executor* executor = nullptr;         ///< executor of the row-parallel stages or nullptr for the pool of the calling worker or the OpenCV threads
+
+  /**
+   * @brief Compares the parameters field by field
+   */
+  [[nodiscard]] bool operator==(const Params&) const = default;
+};
+
+}  // namespace doc_color_decomposer
+
+#endif  // DOC_COLOR_DECOMPOSER_PARAMS_H_
@@ -0,0 +1,77 @@
+#ifndef DOC_COLOR_DECOMPOSER_SEARCH_H_
+#define DOC_COLOR_DECOMPOSER_SEARCH_H_
+
+#include <cstddef>
+#include <functional>
+#include <utility>
+#include <vector>
+
+#include <opencv2/core/core.hpp>
+
+#include "doc_color_decomposer/params.h"
+#include "doc_color_decomposer/thread_pool.h"
+
+namespace doc_color_decomposer {
+
+/**
+ * @brief Document of a dataset with its ground truth
+ */
+struct SearchSample {
+  cv::Mat src;                       ///< source image of the document in the sRGB format
+  std::vector<cv::Mat> truth_masks;  ///< ground-truth binary masks in the grayscale format
+  cv::Mat truth_labels;              ///< ground-truth label image in the grayscale format used instead of the masks if not empty
+};
+
+/**
+ * @brief Grid of the parameters to evaluate
+ */
+struct SearchGrid {
+  std::vector<int> tolerances = {35};                                  ///< odd positive tolerances
+  std::vector<double> peak_factors = {0.025};                          ///< minimum prominences of the peaks relative to the highest one
+  std::vector<std::pair<double, double>> thresholds = {{10.0, 50.0}};  ///< pairs of the saturation and the lightness thresholds of the preprocessing
+  bool preprocessing = true;                                           ///< true if the images need to be preprocessed
+  Engine engine = Engine::kReference;                                  ///< engine of the colors projection
+};
+
+/**
+ * @brief Quality of a point of the grid over the dataset
+ */
+struct SearchResult {
+  Params params;            ///< parameters of the point
+  double mean_pq = 0.0;     ///< mean Panoptic Quality
+  double p10_pq = 0.0;      ///< 10th percentile of the Panoptic Quality
+  double median_pq = 0.0;   ///< median Panoptic Quality
+  double p90_pq = 0.0;      ///< 90th percentile of the Panoptic Quality
+  std::vector<double> pqs;  ///< Panoptic Quality of every document in the order of the dataset
+};
+
+/**
+ * @brief Evaluates every point of the grid on every document of the dataset in parallel
+ *
+ * @details Each document is preprocessed and projected once per pair of the thresholds,
+ * while all the tolerances and the peak factors reuse its histogram and color tables via DocColorDecomposer::Retune();
+ * the scale space is precomputed only for the tolerances of the grid and the document is labeled once per point
+ *
+ * @param[in] samples number of the documents in the dataset
+ * @param[in] load_sample function that loads a document by its index, called once per document from the workers of the pool
+ * @param[in] grid parameters to evaluate
+ * @param[in] pool pool to run the evaluation on
+ *
+ * @return qualities of the points of the grid sorted by the mean Panoptic Quality in the descending order
+ */
+[[nodiscard]] std::vector<SearchResult> SearchParams(std::size_t samples, const std::function<SearchSample(std::size_t)>& load_sample, const SearchGrid& grid, ThreadPool& pool);
+
+/**
+ * @brief Evaluates every point of the grid on every document of the loaded dataset in parallel
+ *
+ * @param[in] samples documents of the dataset with their ground truth
+ * @param[in] grid parameters to evaluate
+ * @param[in] pool pool to run the evaluation on
+ *
+ * @return qualities of the points of the grid sorted by the mean Panoptic Quality in the descending order
+ */
+[[nodiscard]] std::vector<SearchResult> SearchParams(const std::vector<SearchSample>& samples, const SearchGrid& grid, ThreadPool& pool);
+
+}  // namespace doc_color_decomposer
+
+#endif  // DOC_COLOR_DECOMPOSER_SEARCH_H_
@@ -0,0 +1,135 @@
+#ifndef DOC_COLOR_DECOMPOSER_SPARSE_MASK_H_
+#define DOC_COLOR_DECOMPOSER_SPARSE_MASK_H_
+
+#include <istream>
+#include <ostream>
+#include <vector>
+
+#include <opencv2/core/core.hpp>
+
+namespace doc_color_decomposer {
+
+/**
+ * @brief Horizontal run of the consecutive pixels of a mask
+ */
+struct MaskRun {
+  int y = 0;    ///< index of the row of the run
+  int x = 0;    ///< index of the first column of the run
+  int len = 0;  ///< number of the pixels in the run
+};
+
+/**
+ * @brief Binary mask stored as the runs of its rows with its bounding box
+ *
+ * @details Memory and the costs of the operations are proportional to the number of the runs instead of the size of the image
+ */
+class [[nodiscard]] SparseMask final {
+ public:
+  /**
+   * @brief Constructs an empty mask of an empty image
+   */
+  explicit SparseMask() = default;
+
+  /**
+   * @brief Constructs a mask from the non-zero pixels of a dense one
+   *
+   * @param[in] mask binary mask in the grayscale format
+   */
+  explicit SparseMask(const cv::Mat& mask);
+
+  /**
+   * @brief Constructs a mask from its runs
+   *
+   * @param[in] size width and height of the image of the mask in pixels
+   * @param[in] runs non-overlapping runs of positive lengths sorted by their rows and then by their columns
+   */
+  explicit SparseMask(cv::Size size, std::vector<MaskRun> runs);
+
+  /**
+   * @brief Retrieves the size of the image of the mask
+   *
+   * @return width and height of the image in pixels
+   */
+  [[nodiscard]] cv::Size GetSize() const noexcept;
+
+  /**
+   * @brief Retrieves the bounding box of the pixels of the mask
+   *
+   * @return bounding box that is empty if the mask has no pixels
+   */
+  [[nodiscard]] cv::Rect GetBox() const noexcept;
+
+  /**
+   * @brief Retrieves the runs of the mask
+   *
+   * @return list of the runs sorted by their rows and then by their columns
+   */
+  [[nodiscard]] const std::vector<MaskRun>& GetRuns() const noexcept;
+
+  /**
+   * @brief Retrieves the area of the mask
+   *
+   * @return number of the pixels of the mask
+   */
+  [[nodiscard]] long long CountArea() const noexcept;
+
+  /**
+   * @brief Computes the area of the intersection with another mask by merging the runs of both masks
+   *
+   * @param[in] other mask of an image of the same size
+   *
+   * @return number of the pixels of both masks
+   */
+  [[nodiscard]] long long CountIntersection(const SparseMask& other) const noexcept;
+
+  /**
+   * @brief Computes the Intersection over Union (IoU) with another mask
+   *
+   * @param[in] other mask of an image of the same size
+   *
+   * @return value between 0 and 1 or 0 if both masks are empty
+   */
+  [[nodiscard]] double ComputeIou(const SparseMask& other) const noexcept;
+
+  /**
+   * @brief Rasterizes the whole mask
+   *
+   * @return binary mask in the grayscale format
+   */
+  [[nodiscard]] cv::Mat Rasterize() const;
+
+  /**
+   * @brief Rasterizes the part of the mask inside a region of interest
+   *
+   * @param[in] roi region of the image
+   *
+   * @return binary mask of the size of the region in the grayscale format
+   */
+  [[nodiscard]] cv::Mat Rasterize(const cv::Rect& roi) const;
+
+  /**
+   * @brief Serializes the mask in a binary format
+   *
+   * @param[in] out stream that receives the size and the runs of the mask
+   */
+  void Write(std::ostream& out) const;
+
+  /**
+   * @brief Deserializes a mask written by Write()
+   *
+   * @param[in] in stream that holds the size and the runs of the mask
+   *
+   * @return deserialized mask
+   */
+  [[nodiscard]] static SparseMask Read(std::istream& in);
+
+ private:
+  cv::Size size_;
+  cv::Rect box_;
+  std::vector<MaskRun> runs_;
+  long long area_ = 0;
+};
+
+}  // namespace doc_color_decomposer
+
+#endif  // DOC_COLOR_DECOMPOSER_SPARSE_MASK_H_
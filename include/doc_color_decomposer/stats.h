@@ -0,0 +1,56 @@
+#ifndef DOC_COLOR_DECOMPOSER_STATS_H_
+#define DOC_COLOR_DECOMPOSER_STATS_H_
+
+#include <cstddef>
+#include <ostream>
+#include <string>
+#include <vector>
+
+namespace doc_color_decomposer {
+
+/**
+ * @brief Timing of a single stage of a decomposition
+ */
+struct StageStats {
+  std::string name;      ///< name of the stage
+  double wall_ms = 0.0;  ///< elapsed wall-clock time in milliseconds
+  double cpu_ms = 0.0;   ///< CPU time of the thread running the stage and of its parallel stripes on the other threads in milliseconds
+};
+
+/**
+ * @brief Timings and counters of a decomposition
+ */
+struct Stats {
+  std::vector<StageStats> stages;  ///< stages in the order of their execution
+  long long pixels = 0;            ///< number of the pixels of the document
+  int colors = 0;                  ///< number of the unique colors of the document
+  int clusters = 0;                ///< number of the layers
+  std::size_t table_bytes = 0;     ///< bytes held by the per-color tables after the decomposition
+  std::size_t layer_bytes = 0;     ///< bytes allocated for the layers and the masks so far
+};
+
+/**
+ * @brief Difference between the clusters of an approximate decomposition and the clusters of the exact one
+ */
+struct ClusterDrift {
+  int exact_layers = 0;             ///< number of the layers of the exact decomposition
+  int approximate_layers = 0;       ///< number of the layers of the approximate decomposition
+  int max_boundary_shift = 0;       ///< greatest angular distance in degrees from a cluster boundary to the nearest boundary of the other decomposition
+  double relabeled_fraction = 0.0;  ///< fraction of the chromatic pixels that fall outside the best-matching approximate layer of their exact layer
+};
+
+/**
+ * @brief Starts recording the stages and the parallel stripes of all the decompositions as trace events
+ */
+void StartTracing();
+
+/**
+ * @brief Stops recording the trace events and writes them out
+ *
+ * @param[in] out stream that receives the events in the Chrome trace JSON format
+ */
+void StopTracing(std::ostream& out);
+
+}  // namespace doc_color_decomposer
+
+#endif  // DOC_COLOR_DECOMPOSER_STATS_H_
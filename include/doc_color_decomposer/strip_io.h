@@ -0,0 +1,99 @@
+#ifndef DOC_COLOR_DECOMPOSER_STRIP_IO_H_
+#define DOC_COLOR_DECOMPOSER_STRIP_IO_H_
+
+#include <filesystem>
+#include <fstream>
+
+#include <opencv2/core/core.hpp>
+
+namespace doc_color_decomposer {
+
+/**
+ * @brief Interface of a source that reads an image by horizontal strips
+ */
+class StripReader {
+ public:
+  virtual ~StripReader() = default;
+
+  /**
+   * @brief Retrieves the size of the whole image
+   *
+   * @return width and height of the image in pixels
+   */
+  [[nodiscard]] virtual cv::Size GetSize() const = 0;
+
+  /**
+   * @brief Reads a horizontal strip of the image
+   *
+   * @param[in] y index of the first row of the strip
+   * @param[in] rows number of the rows in the strip
+   *
+   * @return strip of the image in the sRGB format
+   */
+  [[nodiscard]] virtual cv::Mat Read(int y, int rows) = 0;
+};
+
+/**
+ * @brief Interface of a sink that writes an image by consecutive horizontal strips
+ */
+class StripWriter {
+ public:
+  virtual ~StripWriter() = default;
+
+  /**
+   * @brief Appends a horizontal strip to the image
+   *
+   * @param[in] strip strip of the image that follows the previously written ones
+   */
+  virtual void Write(const cv::Mat& strip) = 0;
+};
+
+/**
+ * @brief Reader of binary PPM (P6) images that seeks directly to the requested strips
+ */
+class [[nodiscard]] PnmStripReader final : public StripReader {
+ public:
+  /**
+   * @brief Opens an image and parses its header
+   *
+   * @details Samples with a maximum value below 255 are rescaled to the full 8-bit range
+   *
+   * @param[in] path path to the image in the binary PPM format with 8-bit samples
+   */
+  explicit PnmStripReader(const std::filesystem::path& path);
+
+  [[nodiscard]] cv::Size GetSize() const override;
+
+  [[nodiscard]] cv::Mat Read(int y, int rows) override;
+
+ private:
+  std::ifstream file_;
+  std::streamoff data_offset_;
+  cv::Size size_;
+  int max_value_ = 255;
+};
+
+/**
+ * @brief Writer of binary PPM (P6) or PGM (P5) images depending on the number of channels
+ */
+class [[nodiscard]] PnmStripWriter final : public StripWriter {
+ public:
+  /**
+   * @brief Creates an image and writes its header
+   *
+   * @param[in] path path to the image
+   * @param[in] size width and height of the whole image in pixels
+   * @param[in] channels 3 for images in the sRGB format or 1 for images in the grayscale format
+   */
+  explicit PnmStripWriter(const std::filesystem::path& path, cv::Size size, int channels);
+
+  void Write(const cv::Mat& strip) override;
+
+ private:
+  std::ofstream file_;
+  int channels_;
+};
+
+}  // namespace doc_color_decomposer
+
+#endif  // DOC_COLOR_DECOMPOSER_STRIP_IO_H_
@@ -0,0 +1,125 @@
+#ifndef DOC_COLOR_DECOMPOSER_THREAD_POOL_H_
+#define DOC_COLOR_DECOMPOSER_THREAD_POOL_H_
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include <opencv2/core/core.hpp>
+
+namespace doc_color_decomposer {
+
+/**
+ * @brief Interface of a scheduler that runs the row-parallel stages of the decompositions
+ */
+class Executor {
+ public:
+  virtual ~Executor() = default;
+
+  /**
+   * @brief Retrieves the number of the threads that run the stripes concurrently
+   *
+   * @return number of the threads
+   */
+  [[nodiscard]] virtual int CountThreads() const noexcept = 0;
+
+  /**
+   * @brief Splits the range into stripes, runs them and returns when all the stripes are done
+   *
+   * @param[in] range range of the indices
+   * @param[in] body function that processes a subrange of the indices
+   * @param[in] stripes number of the stripes or a non-positive value to let the executor choose
+   */
+  virtual void ParallelFor(const cv::Range& range, const std::function<void(const cv::Range&)>& body, int stripes = 0) = 0;
+};
+
+/**
+ * @brief Work-stealing pool of threads shared by the documents and by the row blocks inside each of them
+ *
+ * @details Every worker owns a queue from which it takes the newest tasks while idle workers steal the oldest tasks from the others,
+ * and the row-parallel stages of the decompositions running on the pool split their work into tasks of the same pool
+ */
+class [[nodiscard]] ThreadPool final : public Executor {
+ public:
+  /**
+   * @brief Constructs a pool and starts its workers
+   *
+   * @param[in] threads number of the worker threads
+   */
+  explicit ThreadPool(int threads = static_cast<int>(std::thread::hardware_concurrency()));
+
+  ThreadPool(const ThreadPool&) = delete;
+  ThreadPool& operator=(const ThreadPool&) = delete;
+
+  /**
+   * @brief Finishes the queued tasks and joins the workers
+   */
+  ~ThreadPool();
+
+  /**
+   * @brief Retrieves the number of the worker threads
+   *
+   * @return number of the worker threads
+   */
+  [[nodiscard]] int CountThreads() const noexcept override;
+
+  /**
+   * @brief Queues a task to the queue of the calling worker or to one of the queues in a round-robin manner
+   *
+   * @param[in] task task that must not throw
+   */
+  void Submit(std::function<void()> task);
+
+  /**
+   * @brief Splits the range into stripes, runs them on the pool and returns when all the stripes are done
+   *
+   * @details The calling thread runs the stripes not yet taken by the workers and then waits without running the other queued tasks,
+   * so a waiting worker never starts another document on top of its call stack
+   *
+   * @param[in] range range of the indices
+   * @param[in] body function that processes a subrange of the indices
+   * @param[in] stripes number of the stripes or a non-positive value to use four stripes per worker
+   */
+  void ParallelFor(const cv::Range& range, const std::function<void(const cv::Range&)>& body, int stripes = 0) override;
+
+  /**
+   * @brief Runs a single queued task on the calling thread
+   *
+   * @return true if a task was run
+   */
+  bool RunPendingTask();
+
+  /**
+   * @brief Retrieves the pool whose worker is the calling thread
+   *
+   * @return pointer to the pool or nullptr if the calling thread is not a worker
+   */
+  [[nodiscard]] static ThreadPool* GetCurrent() noexcept;
+
+ private:
+  struct Queue {
+    std::mutex mutex;
+    std::deque<std::function<void()>> tasks;
+  };
+
+  void Run(int worker_idx);
+  [[nodiscard]] bool PopTask(std::function<void()>& task);
+
+  std::vector<std::unique_ptr<Queue>> queues_;
+  std::vector<std::thread> workers_;
+  std::mutex idle_mutex_;
+  std::condition_variable idle_cv_;
+  std::atomic<int> pending_ = 0;
+  std::atomic<std::size_t> next_queue_ = 0;
+  bool stopping_ = false;
+};
+
+}  // namespace doc_color_decomposer
+
+#endif  // DOC_COLOR_DECOMPOSER_THREAD_POOL_H_
@@ -0,0 +1,97 @@
+#include "doc_color_decomposer/batch.h"
+
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <ranges>
+#include <utility>
+
+namespace doc_color_decomposer {
+
+std::vector<DocColorDecomposer> DecomposeBatch(const std::vector<cv::Mat>& srcs, ThreadPool& pool, int tolerance, bool preprocessing, Engine engine) {
+  return DecomposeBatch(srcs, pool, Params{.tolerance = tolerance, .preprocessing = preprocessing, .engine = engine});
+}
+
+std::vector<DocColorDecomposer> DecomposeBatch(const std::vector<cv::Mat>& srcs, ThreadPool& pool, const Params& params) {
+  std::vector<DocColorDecomposer> decomposers(srcs.size());
+
+  pool.ParallelFor(cv::Range(0, static_cast<int>(srcs.size())), [&](const cv::Range& range) {
+    for (const auto& i : std::views::iota(range.start, range.end)) {
+      decomposers[i] = DocColorDecomposer(srcs[i], params);
+    }
+  }, static_cast<int>(srcs.size()));
+
+  return decomposers;
+}
+
+void DecomposeBatch(const std::function<std::optional<cv::Mat>()>& produce,
+                    const std::function<void(std::size_t, DocColorDecomposer&&, std::exception_ptr)>& on_complete,
+                    ThreadPool& pool, int tolerance, bool preprocessing, Engine engine) {
+  DecomposeBatch(produce, on_complete, pool, Params{.tolerance = tolerance, .preprocessing = preprocessing, .engine = engine});
+}
+
+void DecomposeBatch(const std::function<std::optional<cv::Mat>()>& produce,
+                    const std::function<void(std::size_t, DocColorDecomposer&&, std::exception_ptr)>& on_complete,
+                    ThreadPool& pool, const Params& params) {
+  const int kMaxInFlight = 2 * pool.CountThreads();
+
+  auto in_flight = std::make_shared<std::atomic<int>>(0);
+  std::mutex complete_mutex;
+  std::exception_ptr complete_error;
+
+  auto wait_until = [&pool, &in_flight](int max_in_flight) {
+    for (int running = in_flight->load(std::memory_order_acquire); running > max_in_flight; running = in_flight->load(std::memory_order_acquire)) {
+      if (!pool.RunPendingTask()) {
+        in_flight->wait(running, std::memory_order_acquire);
+      }
+    }
+  };
+
+  for (std::size_t idx = 0;; ++idx) {
+    wait_until(kMaxInFlight - 1);
+
+    std::optional<cv::Mat> src;
+    try {
+      src = produce();
+    } catch (...) {
+      wait_until(0);
+      throw;
+    }
+    if (!src) {
+      break;
+    }
+
+    in_flight->fetch_add(1, std::memory_order_relaxed);
+    pool.Submit([&, in_flight, idx, src = std::move(*src)] {
+      DocColorDecomposer decomposer;
+      std::exception_ptr error;
+      try {
+        decomposer = DocColorDecomposer(src, params);
+      } catch (...) {
+        error = std::current_exception();
+      }
+
+      {
+        std::lock_guard lock(complete_mutex);
+        try {
+          on_complete(idx, std::move(decomposer), error);
+        } catch (...) {
+          if (!complete_error) {
+            complete_error = std::current_exception();
+          }
+        }
+      }
+
+      in_flight->fetch_sub(1, std::memory_order_release);
+      in_flight->notify_one();
+    });
+  }
+
+  wait_until(0);
+
+  if (complete_error) {
+    std::rethrow_exception(complete_error);
+  }
+}
+
+}  // namespace doc_color_decomposer
@@ -0,0 +1,68 @@
+#include "doc_color_decomposer/cluster_model.h"
+
+#include <stdexcept>
+
+#include <opencv2/core/core.hpp>
+
+#include "utils.h"
+
+namespace doc_color_decomposer {
+
+namespace {
+
+const int kClusterModelVersion = 1;
+
+}  // namespace
+
+void WriteClusterModel(const std::filesystem::path& path, const ClusterModel& model) {
+  cv::FileStorage file(path.string(), cv::FileStorage::WRITE);
+  if (!file.isOpened()) {
+    throw std::runtime_error("Unable to write cluster model: " + path.string());
+  }
+
+  file << "version" << kClusterModelVersion;
+  file << "tolerance" << model.params.tolerance;
+  file << "preprocessing" << static_cast<int>(model.params.preprocessing);
+  file << "saturation_thresh" << model.params.saturation_thresh;
+  file << "lightness_thresh" << model.params.lightness_thresh;
+  file << "peak_factor" << model.params.peak_factor;
+  file << "clusters" << model.clusters;
+
+  file << "palette" << "[";
+  for (const auto& rgb : model.palette) {
+    file << "[:" << rgb[0] << rgb[1] << rgb[2] << "]";
+  }
+  file << "]";
+}
+
+ClusterModel ReadClusterModel(const std::filesystem::path& path) {
+  cv::FileStorage file;
+  try {
+    file.open(path.string(), cv::FileStorage::READ);
+  } catch (const cv::Exception&) {
+  }
+
+  if (!file.isOpened() || static_cast<int>(file["version"]) != kClusterModelVersion) {
+    throw std::runtime_error("Invalid cluster model: " + path.string());
+  }
+
+  ClusterModel model;
+  model.params.tolerance = static_cast<int>(file["tolerance"]);
+  model.params.preprocessing = static_cast<int>(file["preprocessing"]) != 0;
+  model.params.saturation_thresh = static_cast<double>(file["saturation_thresh"]);
+  model.params.lightness_thresh = static_cast<double>(file["lightness_thresh"]);
+  model.params.peak_factor = static_cast<double>(file["peak_factor"]);
+  file["clusters"] >> model.clusters;
+
+  for (const auto& rgb : file["palette"]) {
+    model.palette.push_back({static_cast<int>(rgb[0]), static_cast<int>(rgb[1]), static_cast<int>(rgb[2])});
+  }
+
+  if (!AreValidClusters(model.clusters) || model.palette.size() != model.clusters.size() + 1) {
+    throw std::runtime_error("Invalid cluster model: " + path.string());
+  }
+
+  return model;
+}
+
+}  // namespace doc_color_decomposer
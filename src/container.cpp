@@ -0,0 +1,210 @@
+#include "doc_color_decomposer/container.h"
+
+#include <algorithm>
+#include <array>
+#include <cstring>
+#include <ranges>
+#include <stdexcept>
+#include <type_traits>
+
+#include <opencv2/imgcodecs/imgcodecs.hpp>
+#include <opencv2/imgproc/imgproc.hpp>
+
+#include "utils.h"
+
+namespace doc_color_decomposer {
+
+namespace {
+
+const char kContainerMagic[4] = {'D', 'C', 'D', 'C'};
+const std::int32_t kContainerVersion = 1;
+
+template <typename T>
+void WriteValue(std::ofstream& file, T value) {
+  auto bits = static_cast<std::make_unsigned_t<T>>(value);
+
+  std::array<char, sizeof(T)> bytes;
+  for (auto& byte : bytes) {
+    byte = static_cast<char>(bits & 0xFF);
+    bits >>= 8;
+  }
+
+  file.write(bytes.data(), bytes.size());
+}
+
+template <typename T>
+T ReadValue(std::ifstream& file) {
+  std::array<unsigned char, sizeof(T)> bytes = {};
+  file.read(reinterpret_cast<char*>(bytes.data()), bytes.size());
+
+  std::make_unsigned_t<T> bits = 0;
+  for (const auto& byte : bytes | std::views::reverse) {
+    bits = bits << 8 | byte;
+  }
+
+  return static_cast<T>(bits);
+}
+
+}  // namespace
+
+void WriteContainer(const std::filesystem::path& path, cv::Size size, const std::vector<ContainerLayer>& layers, const std::vector<std::vector<uchar>>& chunks) {
+  std::ofstream file(path, std::ios::binary);
+
+  file.write(kContainerMagic, sizeof(kContainerMagic));
+  WriteValue<std::int32_t>(file, kContainerVersion);
+  WriteValue<std::int32_t>(file, size.width);
+  WriteValue<std::int32_t>(file, size.height);
+  WriteValue<std::int32_t>(file, static_cast<std::int32_t>(layers.size()));
+
+  auto chunk_offset = static_cast<std::int64_t>(sizeof(kContainerMagic) + 4 * sizeof(std::int32_t) + layers.size() * (9 * sizeof(std::int32_t) + 2 * sizeof(std::int64_t)));
+  for (const auto& [layer, chunk] : std::views::zip(layers, chunks)) {
+    for (const auto& value : {layer.phi_from, layer.phi_to, layer.mean_rgb[0], layer.mean_rgb[1], layer.mean_rgb[2], layer.box.x, layer.box.y, layer.box.width, layer.box.height}) {
+      WriteValue<std::int32_t>(file, value);
+    }
+    WriteValue<std::int64_t>(file, chunk_offset);
+    WriteValue<std::int64_t>(file, static_cast<std::int64_t>(chunk.size()));
+
+    chunk_offset += static_cast<std::int64_t>(chunk.size());
+  }
+
+  for (const auto& chunk : chunks) {
+    file.write(reinterpret_cast<const char*>(chunk.data()), static_cast<std::streamsize>(chunk.size()));
+  }
+
+  if (!file) {
+    throw std::runtime_error("Unable to write container: " + path.string());
+  }
+}
+
+ContainerReader::ContainerReader(const std::filesystem::path& path) : file_(path, std::ios::binary) {
+  char magic[sizeof(kContainerMagic)] = {};
+  file_.read(magic, sizeof(magic));
+
+  auto version = ReadValue<std::int32_t>(file_);
+  size_.width = ReadValue<std::int32_t>(file_);
+  size_.height = ReadValue<std::int32_t>(file_);
+  auto layers = ReadValue<std::int32_t>(file_);
+
+  if (!file_ || std::memcmp(magic, kContainerMagic, sizeof(magic)) != 0 || version != kContainerVersion || size_.width <= 0 || size_.height <= 0 || layers <= 0 || layers > 256) {
+    throw std::runtime_error("Invalid container: " + path.string());
+  }
+
+  std::int64_t file_size = static_cast<std::int64_t>(std::filesystem::file_size(path));
+
+  layers_.resize(layers);
+  chunk_offsets_.resize(layers);
+  chunk_sizes_.resize(layers);
+
+  for (const auto& layer_idx : std::views::iota(0, static_cast<int>(layers))) {
+    ContainerLayer& layer = layers_[layer_idx];
+
+    layer.phi_from = ReadValue<std::int32_t>(file_);
+    layer.phi_to = ReadValue<std::int32_t>(file_);
+    for (auto& c : layer.mean_rgb) {
+      c = ReadValue<std::int32_t>(file_);
+    }
+    layer.box.x = ReadValue<std::int32_t>(file_);
+    layer.box.y = ReadValue<std::int32_t>(file_);
+    layer.box.width = ReadValue<std::int32_t>(file_);
+    layer.box.height = ReadValue<std::int32_t>(file_);
+
+    chunk_offsets_[layer_idx] = ReadValue<std::int64_t>(file_);
+    chunk_sizes_[layer_idx] = ReadValue<std::int64_t>(file_);
+
+    bool valid_phis = layer.phi_from == -1 ? layer.phi_to == -1 : layer.phi_from >= 0 && layer.phi_from < 360 && layer.phi_to >= 0 && layer.phi_to < 360;
+    bool valid_rgb = std::ranges::all_of(layer.mean_rgb, [](int c) { return c >= 0 && c <= 255; });
+    bool valid_chunk = chunk_offsets_[layer_idx] >= 0 && chunk_sizes_[layer_idx] >= 0 && chunk_sizes_[layer_idx] <= file_size - chunk_offsets_[layer_idx];
+
+    if ((layer.box & cv::Rect(cv::Point(), size_)) != layer.box || !valid_phis || !valid_rgb || !valid_chunk) {
+      throw std::runtime_error("Invalid container: " + path.string());
+    }
+  }
+
+  if (!file_) {
+    throw std::runtime_error("Truncated container: " + path.string());
+  }
+}
+
+cv::Size ContainerReader::GetSize() const noexcept {
+  return size_;
+}
+
+int ContainerReader::CountLayers() const noexcept {
+  return static_cast<int>(layers_.size());
+}
+
+const std::vector<ContainerLayer>& ContainerReader::GetLayerInfos() const noexcept {
+  return layers_;
+}
+
+cv::Mat ContainerReader::ReadLayer(int layer_idx) {
+  cv::Mat chunk = ReadChunk(layer_idx);
+  cv::Mat layer(size_, CV_8UC3, cv::Scalar(255, 255, 255));
+
+  if (!chunk.empty()) {
+    cv::Mat bgr;
+    cv::Mat alpha;
+    cv::cvtColor(chunk, bgr, cv::COLOR_BGRA2BGR);
+    cv::extractChannel(chunk, alpha, 3);
+
+    bgr.copyTo(layer(layers_[layer_idx].box), alpha);
+  }
+
+  return layer;
+}
+
+cv::Mat ContainerReader::ReadMask(int layer_idx) {
+  cv::Mat chunk = ReadChunk(layer_idx);
+  cv::Mat mask = cv::Mat::zeros(size_, CV_8UC1);
+
+  if (!chunk.empty()) {
+    cv::extractChannel(chunk, mask(layers_[layer_idx].box), 3);
+  }
+
+  return mask;
+}
+
+cv::Mat ContainerReader::ReadLabels() {
+  cv::Mat labels = cv::Mat::zeros(size_, CV_8UC1);
+
+  for (const auto& layer_idx : std::views::iota(0, CountLayers())) {
+    cv::Mat chunk = ReadChunk(layer_idx);
+
+    if (!chunk.empty()) {
+      cv::Mat alpha;
+      cv::extractChannel(chunk, alpha, 3);
+
+      labels(layers_[layer_idx].box).setTo(layer_idx, alpha);
+    }
+  }
+
+  return labels;
+}
+
+cv::Mat ContainerReader::ReadChunk(int layer_idx) {
+  if (layer_idx < 0 || layer_idx >= CountLayers()) {
+    throw std::out_of_range("Layer index is out of range");
+  }
+
+  if (chunk_sizes_[layer_idx] == 0 || layers_[layer_idx].box.empty()) {
+    return {};
+  }
+
+  std::vector<uchar> bytes(chunk_sizes_[layer_idx]);
+  file_.clear();
+  file_.seekg(chunk_offsets_[layer_idx]);
+  file_.read(reinterpret_cast<char*>(bytes.data()), static_cast<std::streamsize>(bytes.size()));
+
+  if (!file_) {
+    throw std::runtime_error("Truncated container");
+  }
+
+  cv::Mat chunk = cv::imdecode(bytes, cv::IMREAD_UNCHANGED);
+  if (chunk.type() != CV_8UC4 || chunk.size() != layers_[layer_idx].box.size()) {
+    throw std::runtime_error("Invalid container chunk");
+  }
+
+  return chunk;
+}
+
+}  // namespace doc_color_decomposer
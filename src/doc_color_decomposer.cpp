@@ -1,359 +1,902 @@
 #include "doc_color_decomposer/doc_color_decomposer.h"
 
 #include <algorithm>
+#include <atomic>
+#include <chrono>
 #include <cmath>
+#include <format>
 #include <functional>
-#include <iomanip>
 #include <iterator>
 #include <numeric>
 #include <random>
 #include <ranges>
-#include <sstream>
+#include <stdexcept>
+#include <string_view>
 #include <utility>
 
 #include <opencv2/imgcodecs/imgcodecs.hpp>
 #include <opencv2/imgproc/imgproc.hpp>
 
 #include "data.h"
+#include "phi_kernel.h"
+#include "trace.h"
 #include "utils.h"
 
 namespace doc_color_decomposer {
 
-DocColorDecomposer::DocColorDecomposer(const cv::Mat& src, int tolerance, bool preprocessing) {
-  src_ = src;
-  processed_src_ = preprocessing ? ThreshLightness(ThreshSaturation(SmoothHue(src))) : src_;
-  tolerance_ = tolerance;
+namespace {
+
+const std::size_t kPlotReserve = 4096;
+const std::size_t kPlot3DRgbSamples = 5000;
+
+const char kPlotPreamble[] =
+    "\\documentclass[tikz, border=1cm]{standalone}\n"
+    "\\usepackage{pgfplots}\n"
+    "\\pgfplotsset{compat=newest}\n\n"
+    "\\pagecolor{black}\n"
+    "\\color{white}\n\n"
+    "\\begin{document}\n"
+    "\\begin{tikzpicture}\n\n";
+
+const char kPlotEnding[] =
+    "\\end{axis}\n"
+    "\\end{tikzpicture}\n"
+    "\\end{document}\n";
 
-  rgb_to_n_ = ColorToN(processed_src_);
+const cv::Mat& GetPlot2dLabBackground() {
+  static const cv::Mat background = cv::imdecode(cv::Mat(1, kPlot2dLabLen, CV_8U, kPlot2dLabData), cv::IMREAD_UNCHANGED);
 
-  ComputePhiHistogram();
-  ComputeSmoothedPhiHistogram();
-  ComputeClusters();
-  ComputeLayers();
+  return background;
 }
 
-std::vector<cv::Mat> DocColorDecomposer::GetLayers() const & noexcept {
-  return layers_;
+template <typename OutputIt>
+OutputIt AppendText(OutputIt out, std::string_view text) {
+  return std::copy(text.begin(), text.end(), out);
 }
 
-std::vector<cv::Mat> DocColorDecomposer::GetMasks() const & noexcept {
-  return masks_;
+template <typename OutputIt>
+OutputIt AppendPlot1DAxis(OutputIt out, int max_n) {
+  out = AppendText(out,
+      "\\begin{axis}[\n"
+      "  height=10cm,\n"
+      "  width=30cm,\n"
+      "  xmin=0, xmax=360,\n");
+  out = std::format_to(out, "  ymin=0, ymax={},\n", max_n);
+  return AppendText(out,
+      "  tick style={white},\n"
+      "  xtick style={draw=none},\n"
+      "  xlabel={$\\phi$},\n"
+      "  ylabel={$n$}\n"
+      "]\n\n");
 }
 
-double DocColorDecomposer::ComputeQuality(const std::vector<cv::Mat>& truth_masks) const & {
-  return ComputePq(masks_, truth_masks);
-}
-
-std::string DocColorDecomposer::Plot3DRgb(double yaw, double pitch) & {
-  std::stringstream plot;
-  plot << std::fixed << std::setprecision(4);
-
-  plot << "\\documentclass[tikz, border=1cm]{standalone}\n";
-  plot << "\\usepackage{pgfplots}\n";
-  plot << "\\pgfplotsset{compat=newest}\n\n";
-
-  plot << "\\pagecolor{black}\n";
-  plot << "\\color{white}\n\n";
-
-  plot << "\\begin{document}\n";
-  plot << "\\begin{tikzpicture}\n\n";
-
-  plot << "\\begin{axis}[\n";
-  plot << "  view={" << yaw << "}{" << pitch << "},\n";
-  plot << "  height=10cm,\n";
-  plot << "  width=10cm,\n";
-  plot << "  scale only axis,\n";
-  plot << "  xmin=0, xmax=1,\n";
-  plot << "  ymin=0, ymax=1,\n";
-  plot << "  zmin=0, zmax=1,\n";
-  plot << "  tick style={white},\n";
-  plot << "  xlabel={$R$},\n";
-  plot << "  ylabel={$G$},\n";
-  plot << "  zlabel={$B$}\n";
-  plot << "]\n\n";
-
-  plot << "\\addplot3[\n";
-  plot << "  scatter,\n";
-  plot << "  scatter/@pre marker code/.code={\n";
-  plot << "    \\edef\\temp{\\noexpand\\definecolor{mycolor}{rgb}{\\pgfplotspointmeta}}\n";
-  plot << "    \\temp\n";
-  plot << "    \\scope[color=mycolor]\n";
-  plot << "  },\n";
-  plot << "  scatter/@post marker code/.code={\n";
-  plot << "    \\endscope\n";
-  plot << "  },\n";
-  plot << "  only marks,\n";
-  plot << "  mark size=0.01cm,\n";
-  plot << "  point meta={TeX code symbolic={\\edef\\pgfplotspointmeta{\\thisrow{R}, \\thisrow{G}, \\thisrow{B}}}}\n";
-  plot << "]\n";
-  plot << "table[] {\n";
-  plot << "R G B\n";
+template <typename OutputIt>
+OutputIt AppendPlot1DBar(OutputIt out, int phi, const std::array<int, 3>& mean_rgb, long prev_n, long next_n) {
+  double r = mean_rgb[0] / 255.0;
+  double g = mean_rgb[1] / 255.0;
+  double b = mean_rgb[2] / 255.0;
+
+  out = AppendText(out,
+      "\\addplot[\n"
+      "  ybar interval,\n");
+  out = std::format_to(out, "  color={{rgb,1: red,{:.4f}; green,{:.4f}; blue,{:.4f}}},\n", r, g, b);
+  out = std::format_to(out, "  fill={{rgb,1: red,{:.4f}; green,{:.4f}; blue,{:.4f}}}\n", r, g, b);
+  out = AppendText(out,
+      "]\n"
+      "table[] {\n"
+      "X Y\n");
+  out = std::format_to(out, "{} {}\n", phi, prev_n);
+  out = std::format_to(out, "{} {}\n", phi + 1, next_n);
+  return AppendText(out, "};\n\n");
+}
 
-  std::vector<std::pair<std::array<int, 3>, int>> shuffled_rgb_to_n;
-  std::ranges::sample(rgb_to_n_, std::back_inserter(shuffled_rgb_to_n), 5000, std::default_random_engine(std::random_device()()));
+}  // namespace
 
-  for (const auto& rgb : shuffled_rgb_to_n | std::views::keys) {
-    double r = rgb[0] / 255.0;
-    double g = rgb[1] / 255.0;
-    double b = rgb[2] / 255.0;
+DocColorDecomposer::DocColorDecomposer(const cv::Mat& src, int tolerance, bool preprocessing, Engine engine)
+    : DocColorDecomposer(src, Params{.tolerance = tolerance, .preprocessing = preprocessing, .engine = engine}) {}
 
-    plot << r << ' ' << g << ' ' << b << '\n';
+DocColorDecomposer::DocColorDecomposer(const cv::Mat& src, const Params& params) : DocColorDecomposer(src, params, PixelFormat::kBgr) {}
+
+DocColorDecomposer::DocColorDecomposer(const ImageView& view, const Params& params) : DocColorDecomposer(ImageViewToMat(view), params, view.format) {}
+
+DocColorDecomposer::DocColorDecomposer(const cv::Mat& src, const Params& params, PixelFormat format) {
+  params_ = params;
+
+  DecomposeImage(src, format);
+  ReleaseWorkspace();
+}
+
+DocColorDecomposer::DocColorDecomposer(StripReader& reader, int tolerance, bool preprocessing, Engine engine, int strip_rows)
+    : DocColorDecomposer(reader, Params{.tolerance = tolerance, .preprocessing = preprocessing, .engine = engine}, strip_rows) {}
+
+DocColorDecomposer::DocColorDecomposer(StripReader& reader, const Params& params, int strip_rows) {
+  if (strip_rows < 1) {
+    throw std::invalid_argument("Strip rows must be a positive value");
   }
 
-  plot << "};\n\n";
-  plot << "\\end{axis}\n";
-  plot << "\\end{tikzpicture}\n";
-  plot << "\\end{document}\n";
+  params_ = params;
+  params_.sampling = Sampling::kFull;
 
-  return plot.str();
+  key_to_n_.resize(1 << 24);
+
+  RunStage("ReadStrips", [&] {
+    for (const auto& y : std::views::iota(0, reader.GetSize().height) | std::views::stride(strip_rows)) {
+      AccumulateColorToN(ReadStrip(reader, y, strip_rows, params_).second, key_to_n_, keys_, stripe_to_key_to_n_);
+    }
+  });
+  RunStage("ColorToN", [&] { CollectColorToN(keys_, key_to_n_, rgb_to_n_); });
+  RunStage("ComputePhiHistogram", [&] { ComputePhiHistogram(); });
+  RunStage("ComputeSmoothedPhiHistogram", [&] { ComputeSmoothedPhiHistogram(); });
+  RunStage("ComputeClusters", [&] { ComputeClusters(); });
+  RunStage("ComputeRgbToCluster", [&] { ComputeRgbToCluster(); });
+
+  stats_.pixels = static_cast<long long>(reader.GetSize().area());
+  CountTables();
+  ReleaseWorkspace();
 }
 
-cv::Mat DocColorDecomposer::Plot2DLab() & {
-  cv::Mat plot = cv::imdecode(cv::Mat(1, doc_color_decomposer::kPlot2dLabLen, CV_8U, doc_color_decomposer::kPlot2dLabData), cv::IMREAD_UNCHANGED);
+DocColorDecomposer::DocColorDecomposer(const cv::Mat& src, const ClusterModel& model) {
+  params_.threads = model.params.threads;
+  params_.executor = model.params.executor;
 
-  for (const auto& rgb : rgb_to_n_ | std::views::keys) {
-    int r = rgb[0];
-    int g = rgb[1];
-    int b = rgb[2];
+  ApplyModel(model);
+  DecomposeImage(src, PixelFormat::kBgr);
+}
 
-    std::array<int, 3> lab = rgb_to_lab_[rgb];
+ClusterModel DocColorDecomposer::LearnModel(std::size_t pages, const std::function<cv::Mat(std::size_t)>& load_page, const Params& params) {
+  DocColorDecomposer dcd;
+  dcd.params_ = params;
+  dcd.key_to_n_.resize(1 << 24);
+
+  cv::Mat processed_src;
+  dcd.RunStage("ColorToN", [&] {
+    for (const auto& page_idx : std::views::iota(0uz, pages)) {
+      cv::Mat src = load_page(page_idx);
+      if (src.empty()) {
+        continue;
+      }
+
+      if (params.preprocessing) {
+        Preprocess(src, processed_src, kSmoothKerSize, params.saturation_thresh, params.lightness_thresh, PixelFormat::kBgr);
+      } else {
+        processed_src = src;
+      }
+      AccumulateColorToN(SamplePixels(processed_src, params.sampling, params.sample_density), dcd.key_to_n_, dcd.keys_, dcd.stripe_to_key_to_n_);
+    }
+    CollectColorToN(dcd.keys_, dcd.key_to_n_, dcd.rgb_to_n_);
+  });
+  dcd.RunStage("ComputePhiHistogram", [&] { dcd.ComputePhiHistogram(); });
+  dcd.RunStage("ComputeSmoothedPhiHistogram", [&] { dcd.ComputeSmoothedPhiHistogram(); });
+  dcd.RunStage("ComputeClusters", [&] { dcd.ComputeClusters(); });
 
-    int lab_a = lab[0];
-    int lab_b = lab[1];
+  return dcd.ExportModel();
+}
 
-    int x = std::lround(lab_a + 752);
-    int y = std::lround(lab_b + 752);
+ClusterModel DocColorDecomposer::LearnModel(const std::vector<cv::Mat>& srcs, const Params& params) {
+  return LearnModel(srcs.size(), [&srcs](std::size_t page_idx) { return srcs[page_idx]; }, params);
+}
 
-    plot.at<cv::Vec3b>(y, x) = cv::Vec3b(b, g, r);
+void DocColorDecomposer::Decompose(const cv::Mat& src) & {
+  DecomposeImage(src, PixelFormat::kBgr);
+}
+
+void DocColorDecomposer::Decompose(const ImageView& view) & {
+  DecomposeImage(ImageViewToMat(view), view.format);
+}
+
+void DocColorDecomposer::Decompose(const cv::Mat& src, const ClusterModel& model) & {
+  if (src_.empty() && clusters_.empty()) {
+    params_.threads = model.params.threads;
+    params_.executor = model.params.executor;
   }
 
-  return plot;
+  ApplyModel(model);
+  DecomposeImage(src, PixelFormat::kBgr, true);
 }
 
-std::string DocColorDecomposer::Plot1DPhi() & {
-  std::stringstream plot;
-  plot << std::fixed << std::setprecision(4);
+void DocColorDecomposer::WriteLayers(StripReader& reader, const std::function<std::unique_ptr<StripWriter>(int)>& make_writer, bool masking, int strip_rows) const & {
+  if (strip_rows < 1) {
+    throw std::invalid_argument("Strip rows must be a positive value");
+  }
 
-  double max_n;
-  cv::minMaxLoc(phi_histogram_, nullptr, &max_n, nullptr, nullptr);
-  int round_max_n = std::lround(max_n);
+  ExecutorScope executor_scope(params_.executor, params_.threads);
 
-  plot << "\\documentclass[tikz, border=1cm]{standalone}\n";
-  plot << "\\usepackage{pgfplots}\n";
-  plot << "\\pgfplotsset{compat=newest}\n\n";
+  std::vector<std::unique_ptr<StripWriter>> writers;
+  for (const auto& layer_idx : std::views::iota(0, CountLayers())) {
+    writers.push_back(make_writer(layer_idx));
+  }
 
-  plot << "\\pagecolor{black}\n";
-  plot << "\\color{white}\n\n";
+  bool lazy = frozen_clusters_ || params_.sampling != Sampling::kFull;
+  std::vector<uchar> rgb_to_cluster = lazy ? rgb_to_cluster_ : std::vector<uchar>();
 
-  plot << "\\begin{document}\n";
-  plot << "\\begin{tikzpicture}\n\n";
+  cv::Mat labels;
+  for (const auto& y : std::views::iota(0, reader.GetSize().height) | std::views::stride(strip_rows)) {
+    auto [src, processed_src] = ReadStrip(reader, y, strip_rows, params_);
+    if (lazy) {
+      ColorToLabel(processed_src, labels, rgb_to_cluster, phi_to_cluster_);
+    } else {
+      ColorToLabel(processed_src, labels, rgb_to_cluster_);
+    }
 
-  plot << "\\begin{axis}[\n";
-  plot << "  height=10cm,\n";
-  plot << "  width=30cm,\n";
-  plot << "  xmin=0, xmax=360,\n";
-  plot << "  ymin=0, ymax=" << round_max_n << ",\n";
-  plot << "  tick style={white},\n";
-  plot << "  xtick style={draw=none},\n";
-  plot << "  xlabel={$\\phi$},\n";
-  plot << "  ylabel={$n$}\n";
-  plot << "]\n\n";
+    for (const auto& [writer, layer] : std::views::zip(writers, TrackAllocation(masking ? LabelToMasks(labels, CountLayers()) : LabelToLayers(src, labels, CountLayers())))) {
+      writer->Write(layer);
+    }
+  }
+}
 
-  std::vector<std::array<int, 3>> phi_to_mean_rgb = PhiToMeanRgb();
+void DocColorDecomposer::WriteContainer(const std::filesystem::path& path) const & {
+  ExecutorScope executor_scope(params_.executor, params_.threads);
 
-  for (const auto& phi : std::views::iota(0, 359)) {
-    std::array<int, 3> mean_rgb = phi_to_mean_rgb[phi];
+  if (labels_.empty()) {
+    throw std::logic_error("Container requires the document of the instance");
+  }
 
-    double r = mean_rgb[0] / 255.0;
-    double g = mean_rgb[1] / 255.0;
-    double b = mean_rgb[2] / 255.0;
+  std::vector<cv::Rect> boxes = LabelToBoxes(labels_, CountLayers());
+  std::vector<std::array<int, 3>> palette = GetPalette();
 
-    int prev_phi_hist = std::lround(phi_histogram_.at<double>(phi));
-    int next_phi_hist = std::lround(phi_histogram_.at<double>(phi + 1));
+  std::vector<ContainerLayer> layers(CountLayers());
+  for (const auto& [layer_idx, layer] : layers | std::views::enumerate) {
+    if (layer_idx > 0) {
+      int n = static_cast<int>(clusters_.size());
+      layer.phi_from = clusters_[(layer_idx + n - 2) % n];
+      layer.phi_to = clusters_[layer_idx - 1];
+    }
+    layer.mean_rgb = palette[layer_idx];
+    layer.box = boxes[layer_idx];
+  }
 
-    plot << "\\addplot[\n";
-    plot << "  ybar interval,\n";
-    plot << "  color={rgb,1: red," << r << "; green," << g << "; blue," << b << "},\n";
-    plot << "  fill={rgb,1: red," << r << "; green," << g << "; blue," << b << "}\n";
-    plot << "]\n";
-    plot << "table[] {\n";
-    plot << "X Y\n";
-    plot << phi << ' ' << prev_phi_hist << '\n';
-    plot << phi + 1 << ' ' << next_phi_hist << '\n';
-    plot << "};\n\n";
+  std::vector<cv::Mat> coverages;
+  for (const auto& layer : layers) {
+    coverages.push_back(layer.box.empty() ? cv::Mat() : LabelToCoverage(src_(layer.box), labels_(layer.box), static_cast<int>(coverages.size()), format_));
   }
 
-  plot << "\\draw (axis cs:0,0) -- (axis cs:360,0);\n";
-  plot << "\\draw (axis cs:0," << round_max_n << ") -- (axis cs:360," << round_max_n << ");\n\n";
+  std::vector<std::vector<uchar>> chunks(CountLayers());
+  ParallelFor(cv::Range(0, CountLayers()), [&](const cv::Range& range) {
+    for (const auto& layer_idx : std::views::iota(range.start, range.end)) {
+      if (!coverages[layer_idx].empty()) {
+        cv::imencode(".png", coverages[layer_idx], chunks[layer_idx]);
+      }
+    }
+  });
 
-  plot << "\\end{axis}\n";
-  plot << "\\end{tikzpicture}\n";
-  plot << "\\end{document}\n";
+  doc_color_decomposer::WriteContainer(path, labels_.size(), layers, chunks);
+}
 
-  return plot.str();
+void DocColorDecomposer::Retune(int tolerance) & {
+  Retune(tolerance, params_.peak_factor);
 }
 
-std::string DocColorDecomposer::Plot1DClusters() & {
-  std::stringstream plot;
-  plot << std::fixed << std::setprecision(4);
+void DocColorDecomposer::Retune(int tolerance, double peak_factor) & {
+  if (tolerance <= 0 || tolerance % 2 == 0) {
+    throw std::invalid_argument("Tolerance must be an odd positive value");
+  }
 
-  double max_n;
-  cv::minMaxLoc(smoothed_phi_histogram_, nullptr, &max_n, nullptr, nullptr);
-  int round_max_n = std::lround(max_n);
+  if (phi_histogram_.empty()) {
+    throw std::logic_error("Retuning requires the histogram of the instance");
+  }
 
-  plot << "\\documentclass[tikz, border=1cm]{standalone}\n";
-  plot << "\\usepackage{pgfplots}\n";
-  plot << "\\pgfplotsset{compat=newest}\n\n";
+  params_.tolerance = tolerance;
+  params_.peak_factor = peak_factor;
 
-  plot << "\\pagecolor{black}\n";
-  plot << "\\color{white}\n\n";
+  RunStage("ComputeSmoothedPhiHistogram", [&] { ComputeSmoothedPhiHistogram(); });
+  RunStage("ComputeClusters", [&] { ComputeClusters(); });
+  RunStage("ComputeRgbToCluster", [&] { ComputeRgbToCluster(); });
+  if (!processed_src_.empty()) {
+    RunStage("ComputeLabels", [&] { ComputeLabels(); });
+  }
 
-  plot << "\\begin{document}\n";
-  plot << "\\begin{tikzpicture}\n\n";
+  CountTables();
+}
 
-  plot << "\\begin{axis}[\n";
-  plot << "  height=10cm,\n";
-  plot << "  width=30cm,\n";
-  plot << "  xmin=0, xmax=360,\n";
-  plot << "  ymin=0, ymax=" << round_max_n << ",\n";
-  plot << "  tick style={white},\n";
-  plot << "  xtick style={draw=none},\n";
-  plot << "  xlabel={$\\phi$},\n";
-  plot << "  ylabel={$n$}\n";
-  plot << "]\n\n";
+void DocColorDecomposer::PrecomputeScaleSpace(int max_tolerance) & {
+  std::vector<int> tolerances;
+  for (const auto& scale_idx : std::views::iota(0, std::max(max_tolerance, 1) / 2 + 1)) {
+    tolerances.push_back(2 * scale_idx + 1);
+  }
 
-  std::vector<std::array<int, 3>> cluster_to_mean_rgb = ClusterToMeanRgb();
+  PrecomputeScaleSpace(tolerances, params_.peak_factor);
+}
 
-  for (const auto& phi : std::views::iota(0, 359)) {
-    int cluster = phi_to_cluster_[phi];
-    std::array<int, 3> mean_rgb = cluster_to_mean_rgb[cluster];
+void DocColorDecomposer::PrecomputeScaleSpace(const std::vector<int>& tolerances, double peak_factor) & {
+  if (std::ranges::any_of(tolerances, [](int tolerance) { return tolerance <= 0 || tolerance % 2 == 0; })) {
+    throw std::invalid_argument("Tolerance must be an odd positive value");
+  }
+
+  if (phi_histogram_.empty()) {
+    throw std::logic_error("Scale space requires the histogram of the instance");
+  }
 
-    double r = mean_rgb[0] / 255.0;
-    double g = mean_rgb[1] / 255.0;
-    double b = mean_rgb[2] / 255.0;
+  if (tolerances.empty()) {
+    return;
+  }
 
-    auto prev_smoothed_phi_hist = smoothed_phi_histogram_.at<int>(phi);
-    auto next_smoothed_phi_hist = smoothed_phi_histogram_.at<int>(phi + 1);
+  std::size_t scales = std::ranges::max(tolerances) / 2 + 1;
+  if (scale_to_smoothed_phi_histogram_.size() < scales) {
+    scale_to_smoothed_phi_histogram_.resize(scales);
+    scale_to_clusters_.resize(scales);
+  }
 
-    plot << "\\addplot[\n";
-    plot << "  ybar interval,\n";
-    plot << "  color={rgb,1: red," << r << "; green," << g << "; blue," << b << "},\n";
-    plot << "  fill={rgb,1: red," << r << "; green," << g << "; blue," << b << "}\n";
-    plot << "]\n";
-    plot << "table[] {\n";
-    plot << "X Y\n";
-    plot << phi << ' ' << prev_smoothed_phi_hist << '\n';
-    plot << phi + 1 << ' ' << next_smoothed_phi_hist << '\n';
-    plot << "};\n\n";
+  if (peak_factor != scale_peak_factor_) {
+    std::ranges::fill(scale_to_clusters_, std::vector<int>());
+    scale_peak_factor_ = peak_factor;
   }
 
-  for (const auto& cluster : clusters_) {
-    plot << "\\draw (axis cs:" << cluster << ",0) -- (axis cs:" << cluster << ',' << round_max_n << ");\n";
+  RunStage("PrecomputeScaleSpace", [&] {
+    ParallelFor(cv::Range(0, static_cast<int>(tolerances.size())), [&](const cv::Range& range) {
+      for (const auto& tolerance : tolerances | std::views::drop(range.start) | std::views::take(range.size())) {
+        std::size_t scale_idx = tolerance / 2;
+        if (scale_to_smoothed_phi_histogram_[scale_idx].empty()) {
+          scale_to_smoothed_phi_histogram_[scale_idx] = SmoothHistogram(phi_histogram_, tolerance);
+        }
+        if (scale_to_clusters_[scale_idx].empty()) {
+          scale_to_clusters_[scale_idx] = FindClusters(scale_to_smoothed_phi_histogram_[scale_idx], peak_factor);
+        }
+      }
+    });
+  });
+}
+
+ClusterDrift DocColorDecomposer::MeasureDrift() const & {
+  ExecutorScope executor_scope(params_.executor, params_.threads);
+
+  if (processed_src_.empty()) {
+    throw std::logic_error("Drift requires the document of the instance");
+  }
+
+  DocColorDecomposer exact;
+  exact.params_ = params_;
+  exact.params_.sampling = Sampling::kFull;
+  if (coarse_to_fine_ && params_.preprocessing) {
+    exact.rgb_to_n_ = ColorToN(Preprocess(src_, kSmoothKerSize, params_.saturation_thresh, params_.lightness_thresh, format_));
+  } else {
+    exact.rgb_to_n_ = ColorToN(processed_src_, GetProcessedFormat());
   }
+  exact.ComputePhiHistogram();
+  exact.ComputeSmoothedPhiHistogram();
+  exact.ComputeClusters();
+
+  ClusterDrift drift;
+  drift.exact_layers = exact.CountLayers();
+  drift.approximate_layers = CountLayers();
+
+  auto max_shift = [](const std::vector<int>& from, const std::vector<int>& to) {
+    int shift = 0;
+    for (const auto& a : from) {
+      int min_dist = 180;
+      for (const auto& b : to) {
+        min_dist = std::min(min_dist, std::min(std::abs(a - b), 360 - std::abs(a - b)));
+      }
+      shift = std::max(shift, min_dist);
+    }
+
+    return shift;
+  };
+  drift.max_boundary_shift = std::max(max_shift(clusters_, exact.clusters_), max_shift(exact.clusters_, clusters_));
 
-  plot << "\n";
-  plot << "\\draw (axis cs:0,0) -- (axis cs:360,0);\n";
-  plot << "\\draw (axis cs:0," << round_max_n << ") -- (axis cs:360," << round_max_n << ");\n\n";
+  std::vector<double> overlaps(drift.exact_layers * CountLayers(), 0.0);
+  for (const auto& phi : std::views::iota(0, 360)) {
+    overlaps[exact.phi_to_cluster_[phi] * CountLayers() + phi_to_cluster_[phi]] += exact.phi_histogram_.at<double>(phi);
+  }
 
-  plot << "\\end{axis}\n";
-  plot << "\\end{tikzpicture}\n";
-  plot << "\\end{document}\n";
+  double total = cv::sum(exact.phi_histogram_)[0];
+  double matched = 0.0;
+  for (const auto& exact_cluster : std::views::iota(0, drift.exact_layers)) {
+    auto exact_overlaps = overlaps | std::views::drop(exact_cluster * CountLayers()) | std::views::take(CountLayers());
+    matched += std::ranges::max(exact_overlaps);
+  }
+  drift.relabeled_fraction = total > 0.0 ? 1.0 - matched / total : 0.0;
 
-  return plot.str();
+  return drift;
 }
 
-void DocColorDecomposer::ComputePhiHistogram() {
-  phi_histogram_ = cv::Mat::zeros(1, 360, CV_64FC1);
+ClusterModel DocColorDecomposer::ExportModel() const & {
+  ClusterModel model;
+  model.params = params_;
+  model.params.executor = nullptr;
+  model.clusters = clusters_;
+  model.palette = GetPalette();
+
+  return model;
+}
+
+Params DocColorDecomposer::GetParams() const & noexcept {
+  return params_;
+}
+
+int DocColorDecomposer::CountLayers() const & noexcept {
+  return static_cast<int>(clusters_.size()) + 1;
+}
+
+std::vector<cv::Mat> DocColorDecomposer::GetLayers() const & {
+  ExecutorScope executor_scope(params_.executor, params_.threads);
+  return TrackAllocation(LabelToLayers(src_, labels_, CountLayers(), format_));
+}
+
+std::vector<cv::Mat> DocColorDecomposer::GetLayers() && {
+  ExecutorScope executor_scope(params_.executor, params_.threads);
+
+  ReleaseIntermediates();
+  return TrackAllocation(LabelToLayers(src_, labels_, CountLayers(), format_));
+}
+
+cv::Mat DocColorDecomposer::GetLayer(int layer_idx) const & {
+  ExecutorScope executor_scope(params_.executor, params_.threads);
+
+  if (layer_idx < 0 || layer_idx >= CountLayers()) {
+    throw std::out_of_range("Layer index is out of range");
+  }
+
+  return TrackAllocation(LabelToLayer(src_, labels_, layer_idx, format_));
+}
+
+cv::Mat DocColorDecomposer::GetLayer(int layer_idx) && {
+  ReleaseIntermediates();
+  return GetLayer(layer_idx);
+}
+
+std::vector<cv::Mat> DocColorDecomposer::GetMasks() const & {
+  ExecutorScope executor_scope(params_.executor, params_.threads);
+  return TrackAllocation(LabelToMasks(labels_, CountLayers()));
+}
+
+std::vector<cv::Mat> DocColorDecomposer::GetMasks() && {
+  ExecutorScope executor_scope(params_.executor, params_.threads);
+
+  ReleaseIntermediates();
+  return TrackAllocation(LabelToMasks(labels_, CountLayers()));
+}
+
+cv::Mat DocColorDecomposer::GetMask(int layer_idx) const & {
+  ExecutorScope executor_scope(params_.executor, params_.threads);
+
+  if (layer_idx < 0 || layer_idx >= CountLayers()) {
+    throw std::out_of_range("Layer index is out of range");
+  }
+
+  cv::Mat mask;
+  cv::compare(labels_, layer_idx, mask, cv::CMP_EQ);
+
+  return TrackAllocation(mask);
+}
+
+cv::Mat DocColorDecomposer::GetMask(int layer_idx) && {
+  ReleaseIntermediates();
+  return GetMask(layer_idx);
+}
+
+cv::Mat DocColorDecomposer::GetLabels() const & noexcept {
+  return labels_;
+}
+
+cv::Mat DocColorDecomposer::GetLabels() && noexcept {
+  return std::move(labels_);
+}
+
+std::vector<std::array<int, 3>> DocColorDecomposer::GetPalette() const & {
+  return frozen_clusters_ ? model_palette_ : ClusterToMeanRgb();
+}
+
+std::vector<SparseMask> DocColorDecomposer::GetSparseMasks() const & {
+  ExecutorScope executor_scope(params_.executor, params_.threads);
+
+  std::vector<SparseMask> masks = LabelToSparseMasks(labels_, CountLayers());
+  for (const auto& mask : masks) {
+    std::atomic_ref(layer_bytes_).fetch_add(mask.GetRuns().capacity() * sizeof(MaskRun), std::memory_order_relaxed);
+  }
+
+  return masks;
+}
+
+Stats DocColorDecomposer::GetStats() const & {
+  Stats stats = stats_;
+  stats.layer_bytes = std::atomic_ref(layer_bytes_).load(std::memory_order_relaxed);
 
-  for (const auto& [rgb, n] : rgb_to_n_) {
+  return stats;
+}
+
+double DocColorDecomposer::ComputeQuality(const std::vector<cv::Mat>& truth_masks) const & {
+  ExecutorScope executor_scope(params_.executor, params_.threads);
+  return ComputePq(labels_, CountLayers(), truth_masks);
+}
+
+double DocColorDecomposer::ComputeQuality(const cv::Mat& truth_labels) const & {
+  ExecutorScope executor_scope(params_.executor, params_.threads);
+  return ComputePq(labels_, CountLayers(), truth_labels);
+}
+
+double DocColorDecomposer::ComputeQuality(const std::vector<SparseMask>& truth_masks) const & {
+  ExecutorScope executor_scope(params_.executor, params_.threads);
+  return ComputePq(LabelToSparseMasks(labels_, CountLayers()), truth_masks);
+}
+
+std::string DocColorDecomposer::Plot3DRgb(double yaw, double pitch, unsigned seed) & {
+  std::string plot;
+  plot.reserve(kPlotReserve + kPlot3DRgbSamples * 24);
+  AppendPlot3DRgb(std::back_inserter(plot), yaw, pitch, seed);
+
+  return plot;
+}
+
+void DocColorDecomposer::Plot3DRgb(std::ostream& out, double yaw, double pitch, unsigned seed) & {
+  AppendPlot3DRgb(std::ostreambuf_iterator<char>(out), yaw, pitch, seed);
+}
+
+cv::Mat DocColorDecomposer::Plot2DLab() & {
+  RequireColors();
+
+  cv::Mat plot = GetPlot2dLabBackground().clone();
+
+  for (const auto& [rgb, lab] : std::views::zip(rgb_to_n_ | std::views::keys, rgb_to_lab_)) {
     int r = rgb[0];
     int g = rgb[1];
     int b = rgb[2];
 
-    bool is_gray = r == g && g == b && r == b;
-    if (!is_gray) {
-      cv::Mat proj_rgb = (cv::Mat_<int>(1, 3) << r, g, b);
-      cv::Mat proj_lab = ProjOnLab(proj_rgb);
+    int lab_a = lab[0];
+    int lab_b = lab[1];
 
-      auto lab_a = proj_lab.at<int>(0, 0);
-      auto lab_b = proj_lab.at<int>(0, 1);
-      auto lab_l = proj_lab.at<int>(0, 2);
+    int x = std::lround(lab_a + 752);
+    int y = std::lround(lab_b + 752);
 
-      double phi_rad = std::atan2(-lab_b, lab_a);
-      int phi = RadToDeg(phi_rad);
+    plot.at<cv::Vec3b>(y, x) = cv::Vec3b(b, g, r);
+  }
 
-      phi_histogram_.at<double>(phi) += n;
-      rgb_to_lab_[rgb] = {lab_a, lab_b, lab_l};
-      lab_to_phi_[proj_lab] = phi;
+  return plot;
+}
+
+std::string DocColorDecomposer::Plot1DPhi() & {
+  std::string plot;
+  plot.reserve(kPlotReserve + 360 * 256);
+  AppendPlot1DPhi(std::back_inserter(plot));
+
+  return plot;
+}
+
+void DocColorDecomposer::Plot1DPhi(std::ostream& out) & {
+  AppendPlot1DPhi(std::ostreambuf_iterator<char>(out));
+}
+
+std::string DocColorDecomposer::Plot1DClusters() & {
+  std::string plot;
+  plot.reserve(kPlotReserve + 360 * 256);
+  AppendPlot1DClusters(std::back_inserter(plot));
+
+  return plot;
+}
+
+void DocColorDecomposer::Plot1DClusters(std::ostream& out) & {
+  AppendPlot1DClusters(std::ostreambuf_iterator<char>(out));
+}
+
+void DocColorDecomposer::ComputePhiHistogram() {
+  phi_histogram_ = cv::Mat::zeros(1, 360, CV_64FC1);
+  rgb_to_lab_.assign(rgb_to_n_.size(), {0, 0, 0});
+  rgb_to_phi_.assign(rgb_to_n_.size(), -1);
+
+  if (params_.engine == Engine::kVectorized) {
+    std::vector<cv::Vec3b> bgr;
+    bgr.reserve(rgb_to_n_.size());
+    std::ranges::transform(rgb_to_n_ | std::views::keys, std::back_inserter(bgr), [](const auto& rgb) { return cv::Vec3b(rgb[2], rgb[1], rgb[0]); });
+
+    ParallelFor(cv::Range(0, static_cast<int>(bgr.size())), [&](const cv::Range& range) {
+      ComputeLabPhi(bgr.data() + range.start, range.size(), rgb_to_lab_.data() + range.start, rgb_to_phi_.data() + range.start);
+    });
+
+  } else {
+    ParallelFor(cv::Range(0, static_cast<int>(rgb_to_n_.size())), [&](const cv::Range& range) {
+      for (const auto& i : std::views::iota(range.start, range.end)) {
+        ProjColorOnLab(rgb_to_n_[i].first, rgb_to_lab_[i], rgb_to_phi_[i]);
+      }
+    });
+  }
+
+  const int kStripes = std::clamp(CountThreads(), 1, std::max(static_cast<int>(rgb_to_n_.size()), 1));
+
+  std::vector<cv::Mat> stripe_to_phi_histogram(kStripes);
+
+  ParallelFor(cv::Range(0, kStripes), [&](const cv::Range& range) {
+    for (const auto& stripe : std::views::iota(range.start, range.end)) {
+      cv::Mat& phi_histogram = stripe_to_phi_histogram[stripe] = cv::Mat::zeros(1, 360, CV_64FC1);
+
+      std::size_t from = rgb_to_n_.size() * stripe / kStripes;
+      std::size_t to = rgb_to_n_.size() * (stripe + 1) / kStripes;
+      for (const auto& i : std::views::iota(from, to)) {
+        if (rgb_to_phi_[i] != -1) {
+          phi_histogram.at<double>(rgb_to_phi_[i]) += rgb_to_n_[i].second;
+        }
+      }
     }
+  });
+
+  for (const auto& phi_histogram : stripe_to_phi_histogram) {
+    phi_histogram_ += phi_histogram;
   }
 }
 
 void DocColorDecomposer::ComputeSmoothedPhiHistogram() {
-  cv::hconcat(std::vector<cv::Mat>{phi_histogram_, phi_histogram_, phi_histogram_}, smoothed_phi_histogram_);
+  std::size_t scale_idx = params_.tolerance / 2;
+  if (scale_idx < scale_to_smoothed_phi_histogram_.size() && !scale_to_smoothed_phi_histogram_[scale_idx].empty()) {
+    smoothed_phi_histogram_ = scale_to_smoothed_phi_histogram_[scale_idx];
+  } else {
+    smoothed_phi_histogram_ = SmoothHistogram(phi_histogram_, params_.tolerance);
+  }
+}
 
-  cv::GaussianBlur(smoothed_phi_histogram_, smoothed_phi_histogram_, cv::Size(tolerance_, tolerance_), 0.0);
+void DocColorDecomposer::ComputeClusters() {
+  std::size_t scale_idx = params_.tolerance / 2;
+  if (scale_idx < scale_to_clusters_.size() && !scale_to_clusters_[scale_idx].empty() && scale_peak_factor_ == params_.peak_factor) {
+    clusters_ = scale_to_clusters_[scale_idx];
+  } else {
+    clusters_ = FindClusters(smoothed_phi_histogram_, params_.peak_factor);
+  }
 
-  smoothed_phi_histogram_ = smoothed_phi_histogram_(cv::Rect(360, 0, 360, 1));
+  phi_to_cluster_ = MapPhiToCluster(clusters_);
+}
 
-  smoothed_phi_histogram_.convertTo(smoothed_phi_histogram_, CV_32SC1);
+void DocColorDecomposer::ComputeRgbToCluster() {
+  if (params_.sampling != Sampling::kFull) {
+    rgb_to_cluster_.assign(1 << 24, kUnknownLabel);
+  } else if (rgb_to_cluster_.empty()) {
+    rgb_to_cluster_ = std::vector<uchar>(1 << 24, 0);
+  }
+
+  for (const auto& [rgb, phi] : std::views::zip(rgb_to_n_ | std::views::keys, rgb_to_phi_)) {
+    rgb_to_cluster_[rgb[0] << 16 | rgb[1] << 8 | rgb[2]] = static_cast<uchar>(phi == -1 ? 0 : phi_to_cluster_[phi]);
+  }
 }
 
-void DocColorDecomposer::ComputeClusters() {
-  phi_to_cluster_ = std::vector<int>(360, 1);
+void DocColorDecomposer::ComputeLabels() {
+  if (coarse_to_fine_ && params_.preprocessing) {
+    ColorToLabel(processed_src_, labels_, rgb_to_cluster_, phi_to_cluster_, GetProcessedFormat(), params_.saturation_thresh, params_.lightness_thresh);
+  } else if (frozen_clusters_ || params_.sampling != Sampling::kFull) {
+    ColorToLabel(processed_src_, labels_, rgb_to_cluster_, phi_to_cluster_, GetProcessedFormat());
+  } else {
+    ColorToLabel(processed_src_, labels_, rgb_to_cluster_, GetProcessedFormat());
+  }
+}
+
+void DocColorDecomposer::ApplyModel(const ClusterModel& model) {
+  if (!AreValidClusters(model.clusters) || model.palette.size() != model.clusters.size() + 1) {
+    throw std::invalid_argument("Model must hold at most 254 distinct sorted clusters and the palette of its layers");
+  }
+
+  int threads = params_.threads;
+  Executor* executor = params_.executor;
+
+  params_ = model.params;
+  params_.threads = threads;
+  params_.executor = executor;
+  frozen_clusters_ = true;
+  model_palette_ = model.palette;
+  clusters_ = model.clusters;
+  phi_to_cluster_ = MapPhiToCluster(clusters_);
+
+  phi_histogram_.release();
+  smoothed_phi_histogram_.release();
+  rgb_to_n_.clear();
+  rgb_to_lab_.clear();
+  rgb_to_phi_.clear();
+  rgb_to_cluster_.assign(1 << 24, kUnknownLabel);
+}
+
+void DocColorDecomposer::DecomposeImage(const cv::Mat& src, PixelFormat format, bool coarse_to_fine) {
+  src_ = src;
+  format_ = format;
+  coarse_to_fine_ = coarse_to_fine;
+  stats_.stages.clear();
+  layer_bytes_ = 0;
+  scale_to_smoothed_phi_histogram_ = {};
+  scale_to_clusters_ = {};
+
+  ReleaseIfShared(processed_src_);
+  ReleaseIfShared(labels_);
+
+  RunStage("Preprocess", [&] {
+    if (params_.preprocessing && !coarse_to_fine_) {
+      Preprocess(src_, processed_src_, kSmoothKerSize, params_.saturation_thresh, params_.lightness_thresh, format_);
+    } else {
+      processed_src_ = src_;
+    }
+  });
+  if (frozen_clusters_) {
+    if (rgb_to_cluster_.empty()) {
+      rgb_to_cluster_.assign(1 << 24, kUnknownLabel);
+    }
+  } else {
+    key_to_n_.resize(1 << 24);
+    RunStage("ColorToN", [&] {
+      AccumulateColorToN(SamplePixels(processed_src_, params_.sampling, params_.sample_density), key_to_n_, keys_, stripe_to_key_to_n_, GetProcessedFormat());
+      CollectColorToN(keys_, key_to_n_, rgb_to_n_);
+    });
+    RunStage("ComputePhiHistogram", [&] { ComputePhiHistogram(); });
+    RunStage("ComputeSmoothedPhiHistogram", [&] { ComputeSmoothedPhiHistogram(); });
+    RunStage("ComputeClusters", [&] { ComputeClusters(); });
+    RunStage("ComputeRgbToCluster", [&] { ComputeRgbToCluster(); });
+  }
+  RunStage("ComputeLabels", [&] { ComputeLabels(); });
 
-  double max_h;
-  cv::minMaxLoc(smoothed_phi_histogram_, nullptr, &max_h, nullptr, nullptr);
-  int round_max_h = std::lround(0.025 * max_h);
+  stats_.pixels = static_cast<long long>(src_.total());
+  CountTables();
+}
+
+void DocColorDecomposer::ReleaseWorkspace() noexcept {
+  key_to_n_ = {};
+  keys_ = {};
+  stripe_to_key_to_n_ = {};
+}
+
+void DocColorDecomposer::ReleaseIntermediates() noexcept {
+  ReleaseWorkspace();
+  processed_src_.release();
+  rgb_to_n_ = {};
+  rgb_to_lab_ = {};
+  rgb_to_phi_ = {};
+  rgb_to_cluster_ = {};
+}
+
+void DocColorDecomposer::RunStage(const char* name, const std::function<void()>& stage) {
+  ExecutorScope executor_scope(params_.executor, params_.threads);
 
-  std::vector<int> peaks = FindPeaks(smoothed_phi_histogram_, round_max_h);
-  peaks.push_back(peaks[0] + 360);
+  const char* prev_trace_stage = GetTraceStage();
+  SetTraceStage(name);
 
-  std::transform(peaks.begin(), peaks.end() - 1, peaks.begin() + 1, std::back_inserter(clusters_), [](int a, int b) { return (a + b) / 2 % 360; });
-  std::ranges::sort(clusters_);
+  auto wall_start = std::chrono::steady_clock::now();
+  CpuTimer cpu_timer;
 
-  for (const auto& cluster_idx : std::views::iota(0u, clusters_.size() - 1)) {
-    auto l = phi_to_cluster_.begin() + clusters_[cluster_idx];
-    auto r = phi_to_cluster_.begin() + clusters_[cluster_idx + 1];
+  stage();
 
-    std::ranges::fill(l, r, cluster_idx + 2);
+  long long cpu_ns = cpu_timer.GetElapsedNs();
+  auto wall_end = std::chrono::steady_clock::now();
+
+  SetTraceStage(prev_trace_stage);
+  if (IsTracing()) {
+    RecordTraceEvent(name, wall_start, wall_end);
   }
+
+  stats_.stages.push_back({name, std::chrono::duration<double, std::milli>(wall_end - wall_start).count(), cpu_ns / 1000000.0});
 }
 
-void DocColorDecomposer::ComputeLayers() {
-  layers_ = std::vector<cv::Mat>(clusters_.size() + 1);
-  for (auto& layer : layers_) {
-    layer = cv::Mat(processed_src_.rows, processed_src_.cols, CV_8UC3, cv::Vec3b(255, 255, 255));
+void DocColorDecomposer::CountTables() noexcept {
+  stats_.colors = static_cast<int>(rgb_to_n_.size());
+  stats_.clusters = CountLayers();
+  stats_.table_bytes = rgb_to_n_.capacity() * sizeof(rgb_to_n_[0]) + rgb_to_lab_.capacity() * sizeof(rgb_to_lab_[0]) +
+                       rgb_to_phi_.capacity() * sizeof(rgb_to_phi_[0]) + rgb_to_cluster_.capacity() * sizeof(rgb_to_cluster_[0]);
+}
+
+void DocColorDecomposer::RequireColors() const {
+  if (phi_histogram_.empty() || rgb_to_n_.empty()) {
+    throw std::logic_error("Plots require the histogram and the colors of the instance");
   }
+}
+
+PixelFormat DocColorDecomposer::GetProcessedFormat() const noexcept {
+  return params_.preprocessing && !coarse_to_fine_ ? PixelFormat::kBgr : format_;
+}
+
+cv::Mat DocColorDecomposer::TrackAllocation(cv::Mat mat) const noexcept {
+  std::atomic_ref(layer_bytes_).fetch_add(mat.total() * mat.elemSize(), std::memory_order_relaxed);
+
+  return mat;
+}
 
-  masks_ = std::vector<cv::Mat>(clusters_.size() + 1);
-  for (auto& mask : masks_) {
-    mask = cv::Mat::zeros(processed_src_.rows, processed_src_.cols, CV_8UC1);
+std::vector<cv::Mat> DocColorDecomposer::TrackAllocation(std::vector<cv::Mat> mats) const noexcept {
+  for (const auto& mat : mats) {
+    std::atomic_ref(layer_bytes_).fetch_add(mat.total() * mat.elemSize(), std::memory_order_relaxed);
   }
 
-  for (const auto& [y, x] : std::views::cartesian_product(std::views::iota(0, processed_src_.rows), std::views::iota(0, processed_src_.cols))) {
-    const auto& pixel = processed_src_.at<cv::Vec3b>(y, x);
-    std::array<int, 3> rgb = {pixel[2], pixel[1], pixel[0]};
+  return mats;
+}
+
+template <typename OutputIt>
+OutputIt DocColorDecomposer::AppendPlot3DRgb(OutputIt out, double yaw, double pitch, unsigned seed) const {
+  RequireColors();
+
+  out = AppendText(out, kPlotPreamble);
+
+  out = AppendText(out, "\\begin{axis}[\n");
+  out = std::format_to(out, "  view={{{:.4f}}}{{{:.4f}}},\n", yaw, pitch);
+  out = AppendText(out,
+      "  height=10cm,\n"
+      "  width=10cm,\n"
+      "  scale only axis,\n"
+      "  xmin=0, xmax=1,\n"
+      "  ymin=0, ymax=1,\n"
+      "  zmin=0, zmax=1,\n"
+      "  tick style={white},\n"
+      "  xlabel={$R$},\n"
+      "  ylabel={$G$},\n"
+      "  zlabel={$B$}\n"
+      "]\n\n");
+
+  out = AppendText(out,
+      "\\addplot3[\n"
+      "  scatter,\n"
+      "  scatter/@pre marker code/.code={\n"
+      "    \\edef\\temp{\\noexpand\\definecolor{mycolor}{rgb}{\\pgfplotspointmeta}}\n"
+      "    \\temp\n"
+      "    \\scope[color=mycolor]\n"
+      "  },\n"
+      "  scatter/@post marker code/.code={\n"
+      "    \\endscope\n"
+      "  },\n"
+      "  only marks,\n"
+      "  mark size=0.01cm,\n"
+      "  point meta={TeX code symbolic={\\edef\\pgfplotspointmeta{\\thisrow{R}, \\thisrow{G}, \\thisrow{B}}}}\n"
+      "]\n"
+      "table[] {\n"
+      "R G B\n");
 
-    std::array<int, 3> lab = rgb_to_lab_[rgb];
-    int cluster = lab != std::array<int, 3>{0, 0, 0} ? phi_to_cluster_[lab_to_phi_[lab]] : 0;
+  std::vector<std::pair<std::array<int, 3>, int>> shuffled_rgb_to_n;
+  std::ranges::sample(rgb_to_n_, std::back_inserter(shuffled_rgb_to_n), kPlot3DRgbSamples, std::mt19937(seed));
 
-    layers_[cluster].at<cv::Vec3b>(y, x) = src_.at<cv::Vec3b>(y, x);
-    masks_[cluster].at<uchar>(y, x) = 255;
+  for (const auto& rgb : shuffled_rgb_to_n | std::views::keys) {
+    out = std::format_to(out, "{:.4f} {:.4f} {:.4f}\n", rgb[0] / 255.0, rgb[1] / 255.0, rgb[2] / 255.0);
   }
+
+  out = AppendText(out, "};\n\n");
+  return AppendText(out, kPlotEnding);
 }
 
-std::vector<std::array<int, 3>> DocColorDecomposer::PhiToMeanRgb() {
+template <typename OutputIt>
+OutputIt DocColorDecomposer::AppendPlot1DPhi(OutputIt out) const {
+  RequireColors();
+
+  double max_n;
+  cv::minMaxLoc(phi_histogram_, nullptr, &max_n, nullptr, nullptr);
+  int round_max_n = std::lround(max_n);
+
+  out = AppendText(out, kPlotPreamble);
+  out = AppendPlot1DAxis(out, round_max_n);
+
+  std::vector<std::array<int, 3>> phi_to_mean_rgb = PhiToMeanRgb();
+
+  for (const auto& phi : std::views::iota(0, 359)) {
+    out = AppendPlot1DBar(out, phi, phi_to_mean_rgb[phi], std::lround(phi_histogram_.at<double>(phi)), std::lround(phi_histogram_.at<double>(phi + 1)));
+  }
+
+  out = AppendText(out, "\\draw (axis cs:0,0) -- (axis cs:360,0);\n");
+  out = std::format_to(out, "\\draw (axis cs:0,{0}) -- (axis cs:360,{0});\n\n", round_max_n);
+
+  return AppendText(out, kPlotEnding);
+}
+
+template <typename OutputIt>
+OutputIt DocColorDecomposer::AppendPlot1DClusters(OutputIt out) const {
+  RequireColors();
+
+  double max_n;
+  cv::minMaxLoc(smoothed_phi_histogram_, nullptr, &max_n, nullptr, nullptr);
+  int round_max_n = std::lround(max_n);
+
+  out = AppendText(out, kPlotPreamble);
+  out = AppendPlot1DAxis(out, round_max_n);
+
+  std::vector<std::array<int, 3>> cluster_to_mean_rgb = ClusterToMeanRgb();
+
+  for (const auto& phi : std::views::iota(0, 359)) {
+    out = AppendPlot1DBar(out, phi, cluster_to_mean_rgb[phi_to_cluster_[phi]], smoothed_phi_histogram_.at<int>(phi), smoothed_phi_histogram_.at<int>(phi + 1));
+  }
+
+  for (const auto& cluster : clusters_) {
+    out = std::format_to(out, "\\draw (axis cs:{0},0) -- (axis cs:{0},{1});\n", cluster, round_max_n);
+  }
+
+  out = AppendText(out,
+      "\n"
+      "\\draw (axis cs:0,0) -- (axis cs:360,0);\n");
+  out = std::format_to(out, "\\draw (axis cs:0,{0}) -- (axis cs:360,{0});\n\n", round_max_n);
+
+  return AppendText(out, kPlotEnding);
+}
+
+std::vector<std::array<int, 3>> DocColorDecomposer::PhiToMeanRgb() const {
   std::vector<std::array<int, 3>> phi_to_mean_rgb(360);
   std::vector<std::array<int, 3>> phi_to_sum_rgb(360);
   std::vector<int> phi_to_n(360);
 
-  for (const auto& [rgb, n] : rgb_to_n_) {
-    std::array<int, 3> lab = rgb_to_lab_[rgb];
-
-    if (lab != std::array<int, 3>{0, 0, 0}) {
-      int phi = lab_to_phi_[lab];
+  for (const auto& [rgb_n, phi] : std::views::zip(rgb_to_n_, rgb_to_phi_)) {
+    const auto& [rgb, n] = rgb_n;
 
+    if (phi != -1) {
       std::ranges::transform(phi_to_sum_rgb[phi], rgb | std::views::transform([&n](int c) { return c * n; }), phi_to_sum_rgb[phi].begin(), std::plus{});
       phi_to_n[phi] += n;
     }
@@ -371,16 +914,15 @@ std::vector<std::array<int, 3>> DocColorDecomposer::PhiToMeanRgb() {
   return phi_to_mean_rgb;
 }
 
-std::vector<std::array<int, 3>> DocColorDecomposer::ClusterToMeanRgb() {
+std::vector<std::array<int, 3>> DocColorDecomposer::ClusterToMeanRgb() const {
   std::vector<std::array<int, 3>> cluster_to_mean_rgb(clusters_.size() + 1);
   std::vector<std::array<int, 3>> cluster_to_sum_rgb(clusters_.size() + 1);
   std::vector<int> cluster_to_n(clusters_.size() + 1);
 
-  for (const auto& [rgb, n] : rgb_to_n_) {
-    std::array<int, 3> lab = rgb_to_lab_[rgb];
+  for (const auto& [rgb_n, phi] : std::views::zip(rgb_to_n_, rgb_to_phi_)) {
+    const auto& [rgb, n] = rgb_n;
 
-    if (lab != std::array<int, 3>{0, 0, 0}) {
-      int phi = lab_to_phi_[lab];
+    if (phi != -1) {
       int cluster = phi_to_cluster_[phi];
 
       std::ranges::transform(cluster_to_sum_rgb[cluster], rgb | std::views::transform([&n](int c) { return c * n; }), cluster_to_sum_rgb[cluster].begin(), std::plus{});
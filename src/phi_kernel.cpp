@@ -0,0 +1,209 @@
+#include "phi_kernel.h"
+
+#include <cmath>
+#include <ranges>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#include <immintrin.h>
+#define DOC_COLOR_DECOMPOSER_X86_KERNELS
+#endif
+
+#include "utils.h"
+
+namespace doc_color_decomposer {
+
+namespace {
+
+const double kInv255 = 1.0 / 255.0;
+const double kNorm = 1.0 / std::sqrt(3.0);
+const double kNormDotWhite = kNorm + kNorm + kNorm;
+const double kRgbToLab[3][3] = {
+    {-1.0 / std::sqrt(2.0), +1.0 / std::sqrt(2.0), -0.0},
+    {+1.0 / std::sqrt(6.0), +1.0 / std::sqrt(6.0), -2.0 / std::sqrt(6.0)},
+    {+1.0 / std::sqrt(3.0), +1.0 / std::sqrt(3.0), +1.0 / std::sqrt(3.0)}
+};
+
+void StoreLabPhi(const cv::Vec3b& bgr, int lab_a, int lab_b, int lab_l, std::array<int, 3>& lab, int& phi) {
+  bool is_gray = bgr[0] == bgr[1] && bgr[1] == bgr[2];
+  if (!is_gray) {
+    lab = {lab_a, lab_b, lab_l};
+    phi = RadToDeg(std::atan2(-lab_b, lab_a));
+  } else {
+    lab = {0, 0, 0};
+    phi = -1;
+  }
+}
+
+void ComputeLabPhiScalar(const cv::Vec3b* bgr, int n, std::array<int, 3>* lab, int* phi) {
+  for (const auto& i : std::views::iota(0, n)) {
+    double p[3] = {bgr[i][2] * kInv255, bgr[i][1] * kInv255, bgr[i][0] * kInv255};
+    double u[3] = {p[0] - 1.0, p[1] - 1.0, p[2] - 1.0};
+
+    double k = kNormDotWhite / (kNorm * u[0] + kNorm * u[1] + kNorm * u[2]);
+    double q[3] = {1.0 - (p[0] * k + -k), 1.0 - (p[1] * k + -k), 1.0 - (p[2] * k + -k)};
+
+    int t[3];
+    for (const auto& j : std::views::iota(0, 3)) {
+      t[j] = static_cast<int>(std::lrint((q[0] * kRgbToLab[j][0] + q[1] * kRgbToLab[j][1] + q[2] * kRgbToLab[j][2]) * 255.0));
+    }
+
+    StoreLabPhi(bgr[i], t[0], t[1], t[2], lab[i], phi[i]);
+  }
+}
+
+#ifdef DOC_COLOR_DECOMPOSER_X86_KERNELS
+
+__attribute__((target("sse4.2")))
+void ComputeLabPhiSse42(const cv::Vec3b* bgr, int n, std::array<int, 3>* lab, int* phi) {
+  const __m128d kVInv255 = _mm_set1_pd(kInv255);
+  const __m128d kVOne = _mm_set1_pd(1.0);
+  const __m128d kVNorm = _mm_set1_pd(kNorm);
+  const __m128d kVNormDotWhite = _mm_set1_pd(kNormDotWhite);
+  const __m128d kV255 = _mm_set1_pd(255.0);
+
+  int i = 0;
+  for (; i + 2 <= n; i += 2) {
+    __m128d p[3];
+    for (int c = 0; c < 3; ++c) {
+      p[c] = _mm_mul_pd(_mm_set_pd(bgr[i + 1][2 - c], bgr[i][2 - c]), kVInv255);
+    }
+
+    __m128d d = _mm_add_pd(_mm_add_pd(_mm_mul_pd(kVNorm, _mm_sub_pd(p[0], kVOne)), _mm_mul_pd(kVNorm, _mm_sub_pd(p[1], kVOne))), _mm_mul_pd(kVNorm, _mm_sub_pd(p[2], kVOne)));
+    __m128d k = _mm_div_pd(kVNormDotWhite, d);
+    __m128d neg_k = _mm_sub_pd(_mm_setzero_pd(), k);
+
+    __m128d q[3];
+    for (int c = 0; c < 3; ++c) {
+      q[c] = _mm_sub_pd(kVOne, _mm_add_pd(_mm_mul_pd(p[c], k), neg_k));
+    }
+
+    alignas(16) int t[3][4];
+    for (int j = 0; j < 3; ++j) {
+      __m128d s = _mm_add_pd(_mm_add_pd(_mm_mul_pd(q[0], _mm_set1_pd(kRgbToLab[j][0])), _mm_mul_pd(q[1], _mm_set1_pd(kRgbToLab[j][1]))), _mm_mul_pd(q[2], _mm_set1_pd(kRgbToLab[j][2])));
+      _mm_store_si128(reinterpret_cast<__m128i*>(t[j]), _mm_cvtpd_epi32(_mm_mul_pd(s, kV255)));
+    }
+
+    for (int lane = 0; lane < 2; ++lane) {
+      StoreLabPhi(bgr[i + lane], t[0][lane], t[1][lane], t[2][lane], lab[i + lane], phi[i + lane]);
+    }
+  }
+
+  ComputeLabPhiScalar(bgr + i, n - i, lab + i, phi + i);
+}
+
+__attribute__((target("avx2")))
+void ComputeLabPhiAvx2(const cv::Vec3b* bgr, int n, std::array<int, 3>* lab, int* phi) {
+  const __m256d kVInv255 = _mm256_set1_pd(kInv255);
+  const __m256d kVOne = _mm256_set1_pd(1.0);
+  const __m256d kVNorm = _mm256_set1_pd(kNorm);
+  const __m256d kVNormDotWhite = _mm256_set1_pd(kNormDotWhite);
+  const __m256d kV255 = _mm256_set1_pd(255.0);
+
+  int i = 0;
+  for (; i + 4 <= n; i += 4) {
+    __m256d p[3];
+    for (int c = 0; c < 3; ++c) {
+      p[c] = _mm256_mul_pd(_mm256_set_pd(bgr[i + 3][2 - c], bgr[i + 2][2 - c], bgr[i + 1][2 - c], bgr[i][2 - c]), kVInv255);
+    }
+
+    __m256d d = _mm256_add_pd(_mm256_add_pd(_mm256_mul_pd(kVNorm, _mm256_sub_pd(p[0], kVOne)), _mm256_mul_pd(kVNorm, _mm256_sub_pd(p[1], kVOne))), _mm256_mul_pd(kVNorm, _mm256_sub_pd(p[2], kVOne)));
+    __m256d k = _mm256_div_pd(kVNormDotWhite, d);
+    __m256d neg_k = _mm256_sub_pd(_mm256_setzero_pd(), k);
+
+    __m256d q[3];
+    for (int c = 0; c < 3; ++c) {
+      q[c] = _mm256_sub_pd(kVOne, _mm256_add_pd(_mm256_mul_pd(p[c], k), neg_k));
+    }
+
+    alignas(16) int t[3][4];
+    for (int j = 0; j < 3; ++j) {
+      __m256d s = _mm256_add_pd(_mm256_add_pd(_mm256_mul_pd(q[0], _mm256_set1_pd(kRgbToLab[j][0])), _mm256_mul_pd(q[1], _mm256_set1_pd(kRgbToLab[j][1]))), _mm256_mul_pd(q[2], _mm256_set1_pd(kRgbToLab[j][2])));
+      _mm_store_si128(reinterpret_cast<__m128i*>(t[j]), _mm256_cvtpd_epi32(_mm256_mul_pd(s, kV255)));
+    }
+
+    for (int lane = 0; lane < 4; ++lane) {
+      StoreLabPhi(bgr[i + lane], t[0][lane], t[1][lane], t[2][lane], lab[i + lane], phi[i + lane]);
+    }
+  }
+
+  ComputeLabPhiScalar(bgr + i, n - i, lab + i, phi + i);
+}
+
+__attribute__((target("avx512f")))
+void ComputeLabPhiAvx512(const cv::Vec3b* bgr, int n, std::array<int, 3>* lab, int* phi) {
+  const __m512d kVInv255 = _mm512_set1_pd(kInv255);
+  const __m512d kVOne = _mm512_set1_pd(1.0);
+  const __m512d kVNorm = _mm512_set1_pd(kNorm);
+  const __m512d kVNormDotWhite = _mm512_set1_pd(kNormDotWhite);
+  const __m512d kV255 = _mm512_set1_pd(255.0);
+
+  int i = 0;
+  for (; i + 8 <= n; i += 8) {
+    __m512d p[3];
+    for (int c = 0; c < 3; ++c) {
+      p[c] = _mm512_mul_pd(_mm512_set_pd(bgr[i + 7][2 - c], bgr[i + 6][2 - c], bgr[i + 5][2 - c], bgr[i + 4][2 - c], bgr[i + 3][2 - c], bgr[i + 2][2 - c], bgr[i + 1][2 - c], bgr[i][2 - c]), kVInv255);
+    }
+
+    __m512d d = _mm512_add_pd(_mm512_add_pd(_mm512_mul_pd(kVNorm, _mm512_sub_pd(p[0], kVOne)), _mm512_mul_pd(kVNorm, _mm512_sub_pd(p[1], kVOne))), _mm512_mul_pd(kVNorm, _mm512_sub_pd(p[2], kVOne)));
+    __m512d k = _mm512_div_pd(kVNormDotWhite, d);
+    __m512d neg_k = _mm512_sub_pd(_mm512_setzero_pd(), k);
+
+    __m512d q[3];
+    for (int c = 0; c < 3; ++c) {
+      q[c] = _mm512_sub_pd(kVOne, _mm512_add_pd(_mm512_mul_pd(p[c], k), neg_k));
+    }
+
+    alignas(32) int t[3][8];
+    for (int j = 0; j < 3; ++j) {
+      __m512d s = _mm512_add_pd(_mm512_add_pd(_mm512_mul_pd(q[0], _mm512_set1_pd(kRgbToLab[j][0])), _mm512_mul_pd(q[1], _mm512_set1_pd(kRgbToLab[j][1]))), _mm512_mul_pd(q[2], _mm512_set1_pd(kRgbToLab[j][2])));
+      _mm256_store_si256(reinterpret_cast<__m256i*>(t[j]), _mm512_cvtpd_epi32(_mm512_mul_pd(s, kV255)));
+    }
+
+    for (int lane = 0; lane < 8; ++lane) {
+      StoreLabPhi(bgr[i + lane], t[0][lane], t[1][lane], t[2][lane], lab[i + lane], phi[i + lane]);
+    }
+  }
+
+  ComputeLabPhiScalar(bgr + i, n - i, lab + i, phi + i);
+}
+
+#endif  // DOC_COLOR_DECOMPOSER_X86_KERNELS
+
+LabPhiKernel SelectKernel() {
+#ifdef DOC_COLOR_DECOMPOSER_X86_KERNELS
+  if (cv::checkHardwareSupport(CV_CPU_AVX_512F)) {
+    return ComputeLabPhiAvx512;
+  } else if (cv::checkHardwareSupport(CV_CPU_AVX2)) {
+    return ComputeLabPhiAvx2;
+  } else if (cv::checkHardwareSupport(CV_CPU_SSE4_2)) {
+    return ComputeLabPhiSse42;
+  }
+#endif
+  return ComputeLabPhiScalar;
+}
+
+}  // namespace
+
+void ComputeLabPhi(const cv::Vec3b* bgr, int n, std::array<int, 3>* lab, int* phi) {
+  static const LabPhiKernel kKernel = SelectKernel();
+  kKernel(bgr, n, lab, phi);
+}
+
+std::vector<std::pair<std::string, LabPhiKernel>> GetLabPhiKernels() {
+  std::vector<std::pair<std::string, LabPhiKernel>> kernels = {{"scalar", ComputeLabPhiScalar}};
+#ifdef DOC_COLOR_DECOMPOSER_X86_KERNELS
+  if (cv::checkHardwareSupport(CV_CPU_SSE4_2)) {
+    kernels.emplace_back("sse4.2", ComputeLabPhiSse42);
+  }
+  if (cv::checkHardwareSupport(CV_CPU_AVX2)) {
+    kernels.emplace_back("avx2", ComputeLabPhiAvx2);
+  }
+  if (cv::checkHardwareSupport(CV_CPU_AVX_512F)) {
+    kernels.emplace_back("avx512", ComputeLabPhiAvx512);
+  }
+#endif
+
+  return kernels;
+}
+
+}  // namespace doc_color_decomposer
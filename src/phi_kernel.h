@@ -0,0 +1,20 @@
+#ifndef PHI_KERNEL_H_
+#define PHI_KERNEL_H_
+
+#include <array>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <opencv2/core/core.hpp>
+
+namespace doc_color_decomposer {
+
+using LabPhiKernel = void (*)(const cv::Vec3b*, int, std::array<int, 3>*, int*);
+
+void ComputeLabPhi(const cv::Vec3b* bgr, int n, std::array<int, 3>* lab, int* phi);
+[[nodiscard]] std::vector<std::pair<std::string, LabPhiKernel>> GetLabPhiKernels();
+
+}  // namespace doc_color_decomposer
+
+#endif  // PHI_KERNEL_H_
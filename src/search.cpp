@@ -0,0 +1,78 @@
+#include "doc_color_decomposer/search.h"
+
+#include <algorithm>
+#include <cmath>
+#include <numeric>
+#include <ranges>
+
+#include "doc_color_decomposer/doc_color_decomposer.h"
+#include "utils.h"
+
+namespace doc_color_decomposer {
+
+std::vector<SearchResult> SearchParams(std::size_t samples, const std::function<SearchSample(std::size_t)>& load_sample, const SearchGrid& grid, ThreadPool& pool) {
+  std::vector<SearchResult> results;
+  for (const auto& [saturation_thresh, lightness_thresh] : grid.thresholds) {
+    for (const auto& peak_factor : grid.peak_factors) {
+      for (const auto& tolerance : grid.tolerances) {
+        SearchResult result;
+        result.params = {tolerance, grid.preprocessing, saturation_thresh, lightness_thresh, peak_factor, grid.engine};
+        result.pqs = std::vector<double>(samples, 0.0);
+        results.push_back(std::move(result));
+      }
+    }
+  }
+
+  if (results.empty() || samples == 0) {
+    return results;
+  }
+
+  std::size_t points_per_thresholds = grid.peak_factors.size() * grid.tolerances.size();
+
+  pool.ParallelFor(cv::Range(0, static_cast<int>(samples)), [&](const cv::Range& range) {
+    for (const auto& sample_idx : std::views::iota(range.start, range.end)) {
+      SearchSample sample = load_sample(sample_idx);
+
+      ParallelFor(cv::Range(0, static_cast<int>(grid.thresholds.size())), [&](const cv::Range& thresholds_range) {
+        for (const auto& thresholds_idx : std::views::iota(thresholds_range.start, thresholds_range.end)) {
+          auto first_point = results.begin() + thresholds_idx * points_per_thresholds;
+          DocColorDecomposer dcd(sample.src, first_point->params);
+
+          for (const auto& [peak_factor_idx, peak_factor] : grid.peak_factors | std::views::enumerate) {
+            dcd.PrecomputeScaleSpace(grid.tolerances, peak_factor);
+
+            for (auto& result : std::ranges::subrange(first_point, first_point + points_per_thresholds) |
+                                    std::views::drop(peak_factor_idx * grid.tolerances.size()) | std::views::take(grid.tolerances.size())) {
+              if (result.params.tolerance != dcd.GetParams().tolerance || peak_factor != dcd.GetParams().peak_factor) {
+                dcd.Retune(result.params.tolerance, peak_factor);
+              }
+              result.pqs[sample_idx] = sample.truth_labels.empty() ? dcd.ComputeQuality(sample.truth_masks) : dcd.ComputeQuality(sample.truth_labels);
+            }
+          }
+        }
+      });
+    }
+  }, static_cast<int>(samples));
+
+  for (auto& result : results) {
+    std::vector<double> sorted_pqs = result.pqs;
+    std::ranges::sort(sorted_pqs);
+
+    auto percentile = [&sorted_pqs](double p) { return sorted_pqs[std::lround(p * static_cast<double>(sorted_pqs.size() - 1))]; };
+
+    result.mean_pq = std::accumulate(sorted_pqs.begin(), sorted_pqs.end(), 0.0) / static_cast<double>(sorted_pqs.size());
+    result.p10_pq = percentile(0.1);
+    result.median_pq = percentile(0.5);
+    result.p90_pq = percentile(0.9);
+  }
+
+  std::ranges::stable_sort(results, std::ranges::greater{}, &SearchResult::mean_pq);
+
+  return results;
+}
+
+std::vector<SearchResult> SearchParams(const std::vector<SearchSample>& samples, const SearchGrid& grid, ThreadPool& pool) {
+  return SearchParams(samples.size(), [&samples](std::size_t sample_idx) { return samples[sample_idx]; }, grid, pool);
+}
+
+}  // namespace doc_color_decomposer
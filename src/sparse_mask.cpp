@@ -0,0 +1,178 @@
+#include "doc_color_decomposer/sparse_mask.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <ranges>
+#include <stdexcept>
+#include <utility>
+
+namespace doc_color_decomposer {
+
+SparseMask::SparseMask(const cv::Mat& mask) {
+  std::vector<MaskRun> runs;
+
+  for (const auto& y : std::views::iota(0, mask.rows)) {
+    const auto* mask_row = mask.ptr<uchar>(y);
+
+    for (int x = 0; x < mask.cols;) {
+      if (mask_row[x] == 0) {
+        ++x;
+        continue;
+      }
+
+      int len = 1;
+      while (x + len < mask.cols && mask_row[x + len] != 0) {
+        ++len;
+      }
+
+      runs.push_back({y, x, len});
+      x += len;
+    }
+  }
+
+  *this = SparseMask(mask.size(), std::move(runs));
+}
+
+SparseMask::SparseMask(cv::Size size, std::vector<MaskRun> runs) : size_(size), runs_(std::move(runs)) {
+  if (runs_.empty()) {
+    return;
+  }
+
+  int min_x = size_.width;
+  int max_x = 0;
+  for (const auto& run : runs_) {
+    min_x = std::min(min_x, run.x);
+    max_x = std::max(max_x, run.x + run.len);
+    area_ += run.len;
+  }
+
+  box_ = cv::Rect(cv::Point(min_x, runs_.front().y), cv::Point(max_x, runs_.back().y + 1));
+}
+
+cv::Size SparseMask::GetSize() const noexcept {
+  return size_;
+}
+
+cv::Rect SparseMask::GetBox() const noexcept {
+  return box_;
+}
+
+const std::vector<MaskRun>& SparseMask::GetRuns() const noexcept {
+  return runs_;
+}
+
+long long SparseMask::CountArea() const noexcept {
+  return area_;
+}
+
+long long SparseMask::CountIntersection(const SparseMask& other) const noexcept {
+  if ((box_ & other.box_).empty()) {
+    return 0;
+  }
+
+  long long intersection = 0;
+
+  auto it = runs_.begin();
+  auto other_it = other.runs_.begin();
+  while (it != runs_.end() && other_it != other.runs_.end()) {
+    if (it->y < other_it->y) {
+      it = std::ranges::lower_bound(it, runs_.end(), other_it->y, {}, &MaskRun::y);
+      continue;
+    }
+    if (other_it->y < it->y) {
+      other_it = std::ranges::lower_bound(other_it, other.runs_.end(), it->y, {}, &MaskRun::y);
+      continue;
+    }
+
+    int end = std::min(it->x + it->len, other_it->x + other_it->len);
+    intersection += std::max(end - std::max(it->x, other_it->x), 0);
+
+    if (it->x + it->len == end) {
+      ++it;
+    } else {
+      ++other_it;
+    }
+  }
+
+  return intersection;
+}
+
+double SparseMask::ComputeIou(const SparseMask& other) const noexcept {
+  long long intersection = CountIntersection(other);
+  long long union_area = area_ + other.area_ - intersection;
+
+  return union_area > 0 ? static_cast<double>(intersection) / static_cast<double>(union_area) : 0.0;
+}
+
+cv::Mat SparseMask::Rasterize() const {
+  return Rasterize(cv::Rect(cv::Point(), size_));
+}
+
+cv::Mat SparseMask::Rasterize(const cv::Rect& roi) const {
+  cv::Mat mask = cv::Mat::zeros(roi.size(), CV_8UC1);
+
+  for (auto it = std::ranges::lower_bound(runs_, roi.y, {}, &MaskRun::y); it != runs_.end() && it->y < roi.y + roi.height; ++it) {
+    int from = std::max(it->x, roi.x);
+    int to = std::min(it->x + it->len, roi.x + roi.width);
+
+    if (from < to) {
+      std::fill(mask.ptr<uchar>(it->y - roi.y) + from - roi.x, mask.ptr<uchar>(it->y - roi.y) + to - roi.x, 255);
+    }
+  }
+
+  return mask;
+}
+
+void SparseMask::Write(std::ostream& out) const {
+  auto write_value = [&out](std::int32_t value) { out.write(reinterpret_cast<const char*>(&value), sizeof(value)); };
+
+  write_value(size_.width);
+  write_value(size_.height);
+  write_value(static_cast<std::int32_t>(runs_.size()));
+  for (const auto& run : runs_) {
+    write_value(run.y);
+    write_value(run.x);
+    write_value(run.len);
+  }
+
+  if (!out) {
+    throw std::runtime_error("Unable to write sparse mask");
+  }
+}
+
+SparseMask SparseMask::Read(std::istream& in) {
+  auto read_value = [&in] {
+    std::int32_t value = 0;
+    in.read(reinterpret_cast<char*>(&value), sizeof(value));
+
+    return value;
+  };
+
+  cv::Size size;
+  size.width = read_value();
+  size.height = read_value();
+  int n = read_value();
+
+  if (!in || size.width < 0 || size.height < 0 || n < 0) {
+    throw std::runtime_error("Invalid sparse mask");
+  }
+
+  std::vector<MaskRun> runs(n);
+  for (auto& run : runs) {
+    run.y = read_value();
+    run.x = read_value();
+    run.len = read_value();
+
+    if (run.y < 0 || run.y >= size.height || run.x < 0 || run.len <= 0 || run.x + run.len > size.width) {
+      throw std::runtime_error("Invalid sparse mask");
+    }
+  }
+
+  if (!in) {
+    throw std::runtime_error("Truncated sparse mask");
+  }
+
+  return SparseMask(size, std::move(runs));
+}
+
+}  // namespace doc_color_decomposer
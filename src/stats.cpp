@@ -0,0 +1,73 @@
+#include "doc_color_decomposer/stats.h"
+
+#include <atomic>
+#include <mutex>
+#include <ranges>
+
+#include "trace.h"
+
+namespace doc_color_decomposer {
+
+namespace {
+
+struct TraceEvent {
+  const char* name;
+  int thread_idx;
+  std::chrono::steady_clock::time_point start;
+  std::chrono::steady_clock::time_point end;
+};
+
+std::atomic<bool> tracing = false;
+std::atomic<int> next_thread_idx = 0;
+std::mutex trace_mutex;
+std::vector<TraceEvent> trace_events;
+std::chrono::steady_clock::time_point trace_start;
+
+thread_local const char* trace_stage = "ParallelFor";
+thread_local int thread_idx = next_thread_idx++;
+
+}  // namespace
+
+void StartTracing() {
+  std::lock_guard lock(trace_mutex);
+  trace_events.clear();
+  trace_start = std::chrono::steady_clock::now();
+  tracing = true;
+}
+
+void StopTracing(std::ostream& out) {
+  tracing = false;
+
+  std::lock_guard lock(trace_mutex);
+  out << "{\"traceEvents\": [\n";
+
+  for (const auto& [idx, event] : trace_events | std::views::enumerate) {
+    auto ts = std::chrono::duration_cast<std::chrono::microseconds>(event.start - trace_start).count();
+    auto dur = std::chrono::duration_cast<std::chrono::microseconds>(event.end - event.start).count();
+
+    out << "  {\"name\": \"" << event.name << "\", \"ph\": \"X\", \"pid\": 0, \"tid\": " << event.thread_idx << ", \"ts\": " << ts << ", \"dur\": " << dur << '}';
+    out << (idx + 1 < std::ssize(trace_events) ? ",\n" : "\n");
+  }
+
+  out << "]}\n";
+  trace_events.clear();
+}
+
+bool IsTracing() noexcept {
+  return tracing.load(std::memory_order_relaxed);
+}
+
+const char* GetTraceStage() noexcept {
+  return trace_stage;
+}
+
+void SetTraceStage(const char* name) noexcept {
+  trace_stage = name;
+}
+
+void RecordTraceEvent(const char* name, std::chrono::steady_clock::time_point start, std::chrono::steady_clock::time_point end) {
+  std::lock_guard lock(trace_mutex);
+  trace_events.push_back({name, thread_idx, start, end});
+}
+
+}  // namespace doc_color_decomposer
@@ -0,0 +1,95 @@
+#include "doc_color_decomposer/strip_io.h"
+
+#include <cctype>
+#include <ranges>
+#include <stdexcept>
+#include <string>
+
+#include <opencv2/imgproc/imgproc.hpp>
+
+namespace doc_color_decomposer {
+
+namespace {
+
+int ReadPnmValue(std::ifstream& file) {
+  while (std::isspace(file.peek()) || file.peek() == '#') {
+    if (file.get() == '#') {
+      std::string comment;
+      std::getline(file, comment);
+    }
+  }
+
+  int value = -1;
+  file >> value;
+
+  return value;
+}
+
+}  // namespace
+
+PnmStripReader::PnmStripReader(const std::filesystem::path& path) : file_(path, std::ios::binary) {
+  std::string magic(2, '\0');
+  file_.read(magic.data(), 2);
+
+  size_.width = ReadPnmValue(file_);
+  size_.height = ReadPnmValue(file_);
+  max_value_ = ReadPnmValue(file_);
+  file_.get();
+
+  if (!file_ || magic != "P6" || size_.width <= 0 || size_.height <= 0 || max_value_ <= 0 || max_value_ > 255) {
+    throw std::runtime_error("Invalid PPM image: " + path.string());
+  }
+
+  data_offset_ = file_.tellg();
+}
+
+cv::Size PnmStripReader::GetSize() const {
+  return size_;
+}
+
+cv::Mat PnmStripReader::Read(int y, int rows) {
+  if (y < 0 || rows <= 0 || y > size_.height - rows) {
+    throw std::out_of_range("Strip is out of the image");
+  }
+
+  cv::Mat strip(rows, size_.width, CV_8UC3);
+
+  file_.seekg(data_offset_ + static_cast<std::streamoff>(y) * size_.width * 3);
+  file_.read(reinterpret_cast<char*>(strip.data), static_cast<std::streamsize>(strip.total() * 3));
+
+  if (!file_) {
+    throw std::runtime_error("Truncated PPM image");
+  }
+
+  if (max_value_ < 255) {
+    strip.convertTo(strip, CV_8U, 255.0 / max_value_);
+  }
+  cv::cvtColor(strip, strip, cv::COLOR_RGB2BGR);
+
+  return strip;
+}
+
+PnmStripWriter::PnmStripWriter(const std::filesystem::path& path, cv::Size size, int channels) : file_(path, std::ios::binary), channels_(channels) {
+  file_ << (channels_ == 3 ? "P6" : "P5") << '\n' << size.width << ' ' << size.height << '\n' << 255 << '\n';
+
+  if (!file_) {
+    throw std::runtime_error("Unable to write image: " + path.string());
+  }
+}
+
+void PnmStripWriter::Write(const cv::Mat& strip) {
+  cv::Mat samples = strip;
+  if (channels_ == 3) {
+    cv::cvtColor(strip, samples, cv::COLOR_BGR2RGB);
+  }
+
+  for (const auto& y : std::views::iota(0, samples.rows)) {
+    file_.write(samples.ptr<char>(y), static_cast<std::streamsize>(samples.cols * samples.elemSize()));
+  }
+
+  if (!file_) {
+    throw std::runtime_error("Unable to write image strip");
+  }
+}
+
+}  // namespace doc_color_decomposer
@@ -0,0 +1,196 @@
+#include "doc_color_decomposer/thread_pool.h"
+
+#include <algorithm>
+#include <exception>
+#include <iterator>
+#include <memory>
+#include <ranges>
+#include <utility>
+
+namespace doc_color_decomposer {
+
+namespace {
+
+thread_local ThreadPool* current_pool = nullptr;
+thread_local int current_worker_idx = -1;
+
+struct ParallelLoop {
+  const std::function<void(const cv::Range&)>* body = nullptr;
+  cv::Range range;
+  int stripes = 0;
+  std::atomic<int> next_stripe = 0;
+  std::atomic<int> remaining = 0;
+  std::mutex error_mutex;
+  std::exception_ptr error;
+
+  bool RunNextStripe() {
+    int stripe = next_stripe.fetch_add(1, std::memory_order_relaxed);
+    if (stripe >= stripes) {
+      return false;
+    }
+
+    int len = range.size();
+    try {
+      (*body)(cv::Range(range.start + static_cast<int>(static_cast<long long>(len) * stripe / stripes), range.start + static_cast<int>(static_cast<long long>(len) * (stripe + 1) / stripes)));
+    } catch (...) {
+      std::lock_guard lock(error_mutex);
+      if (!error) {
+        error = std::current_exception();
+      }
+    }
+
+    if (remaining.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+      remaining.notify_all();
+    }
+
+    return true;
+  }
+};
+
+}  // namespace
+
+ThreadPool::ThreadPool(int threads) {
+  threads = std::max(threads, 1);
+
+  std::ranges::generate_n(std::back_inserter(queues_), threads, [] { return std::make_unique<Queue>(); });
+  for (const auto& worker_idx : std::views::iota(0, threads)) {
+    workers_.emplace_back(&ThreadPool::Run, this, worker_idx);
+  }
+}
+
+ThreadPool::~ThreadPool() {
+  {
+    std::lock_guard lock(idle_mutex_);
+    stopping_ = true;
+  }
+  idle_cv_.notify_all();
+
+  for (auto& worker : workers_) {
+    worker.join();
+  }
+}
+
+int ThreadPool::CountThreads() const noexcept {
+  return static_cast<int>(workers_.size());
+}
+
+void ThreadPool::Submit(std::function<void()> task) {
+  bool is_worker = current_pool == this && current_worker_idx != -1;
+  std::size_t queue_idx = is_worker ? current_worker_idx : next_queue_++ % queues_.size();
+
+  {
+    std::lock_guard lock(queues_[queue_idx]->mutex);
+    queues_[queue_idx]->tasks.push_back(std::move(task));
+  }
+  {
+    std::lock_guard lock(idle_mutex_);
+    ++pending_;
+  }
+  idle_cv_.notify_one();
+}
+
+void ThreadPool::ParallelFor(const cv::Range& range, const std::function<void(const cv::Range&)>& body, int stripes) {
+  int len = range.size();
+  if (len <= 0) {
+    return;
+  }
+  stripes = std::clamp(stripes > 0 ? stripes : 4 * CountThreads(), 1, len);
+
+  auto loop = std::make_shared<ParallelLoop>();
+  loop->body = &body;
+  loop->range = range;
+  loop->stripes = stripes;
+  loop->remaining = stripes;
+
+  for ([[maybe_unused]] const auto& stripe : std::views::iota(1, stripes)) {
+    Submit([loop] { loop->RunNextStripe(); });
+  }
+
+  while (loop->RunNextStripe()) {
+  }
+
+  for (int remaining = loop->remaining.load(std::memory_order_acquire); remaining > 0; remaining = loop->remaining.load(std::memory_order_acquire)) {
+    loop->remaining.wait(remaining, std::memory_order_acquire);
+  }
+
+  if (loop->error) {
+    std::rethrow_exception(loop->error);
+  }
+}
+
+bool ThreadPool::RunPendingTask() {
+  std::function<void()> task;
+  if (!PopTask(task)) {
+    return false;
+  }
+
+  if (current_pool == this) {
+    task();
+    return true;
+  }
+
+  ThreadPool* prev_pool = std::exchange(current_pool, this);
+  int prev_worker_idx = std::exchange(current_worker_idx, -1);
+
+  task();
+
+  current_pool = prev_pool;
+  current_worker_idx = prev_worker_idx;
+
+  return true;
+}
+
+ThreadPool* ThreadPool::GetCurrent() noexcept {
+  return current_pool;
+}
+
+void ThreadPool::Run(int worker_idx) {
+  current_pool = this;
+  current_worker_idx = worker_idx;
+
+  while (true) {
+    if (RunPendingTask()) {
+      continue;
+    }
+
+    std::unique_lock lock(idle_mutex_);
+    idle_cv_.wait(lock, [this] { return stopping_ || pending_ > 0; });
+
+    if (stopping_ && pending_ <= 0) {
+      return;
+    }
+  }
+}
+
+bool ThreadPool::PopTask(std::function<void()>& task) {
+  bool is_worker = current_pool == this && current_worker_idx != -1;
+
+  if (is_worker) {
+    Queue& own_queue = *queues_[current_worker_idx];
+    std::lock_guard lock(own_queue.mutex);
+
+    if (!own_queue.tasks.empty()) {
+      task = std::move(own_queue.tasks.back());
+      own_queue.tasks.pop_back();
+      --pending_;
+      return true;
+    }
+  }
+
+  std::size_t first_victim_idx = is_worker ? current_worker_idx + 1 : 0;
+  for (const auto& i : std::views::iota(0uz, queues_.size())) {
+    Queue& victim_queue = *queues_[(first_victim_idx + i) % queues_.size()];
+    std::lock_guard lock(victim_queue.mutex);
+
+    if (!victim_queue.tasks.empty()) {
+      task = std::move(victim_queue.tasks.front());
+      victim_queue.tasks.pop_front();
+      --pending_;
+      return true;
+    }
+  }
+
+  return false;
+}
+
+}  // namespace doc_color_decomposer
@@ -0,0 +1,17 @@
+#ifndef TRACE_H_
+#define TRACE_H_
+
+#include <chrono>
+
+namespace doc_color_decomposer {
+
+[[nodiscard]] bool IsTracing() noexcept;
+
+[[nodiscard]] const char* GetTraceStage() noexcept;
+void SetTraceStage(const char* name) noexcept;
+
+void RecordTraceEvent(const char* name, std::chrono::steady_clock::time_point start, std::chrono::steady_clock::time_point end);
+
+}  // namespace doc_color_decomposer
+
+#endif  // TRACE_H_
@@ -1,73 +1,592 @@
 #include "utils.h"
 
 #include <algorithm>
+#include <atomic>
+#include <chrono>
 #include <cmath>
 #include <cstddef>
+#include <ctime>
+#include <iterator>
+#include <mutex>
 #include <numbers>
 #include <ranges>
+#include <stdexcept>
+#include <thread>
 
 #include <opencv2/imgproc/imgproc.hpp>
 
+#include "phi_kernel.h"
+#include "trace.h"
+
 namespace doc_color_decomposer {
 
-cv::Mat SmoothHue(cv::Mat src, int ker_size) {
-  cv::Mat smoothed_src;
-  cv::GaussianBlur(src, smoothed_src, cv::Size(ker_size, ker_size), ker_size);
+namespace {
+
+thread_local Executor* current_executor = nullptr;
+thread_local int current_threads = 0;
 
-  cv::cvtColor(src, src, cv::COLOR_BGR2HLS_FULL);
-  cv::cvtColor(smoothed_src, smoothed_src, cv::COLOR_BGR2HLS_FULL);
+thread_local std::atomic<long long>* current_stripes_ns = nullptr;
 
-  const int kFromTo[] = {0, 0};
-  cv::mixChannels(&smoothed_src, 1, &src, 1, kFromTo, 1);
+Executor* GetExecutor() {
+  return current_executor != nullptr ? current_executor : ThreadPool::GetCurrent();
+}
 
-  cv::cvtColor(src, src, cv::COLOR_HLS2BGR_FULL);
+long long GetThreadCpuNs() noexcept {
+#ifdef CLOCK_THREAD_CPUTIME_ID
+  timespec time;
+  clock_gettime(CLOCK_THREAD_CPUTIME_ID, &time);
 
-  return src;
+  return time.tv_sec * 1000000000LL + time.tv_nsec;
+#else
+  return static_cast<long long>(std::clock()) * (1000000000LL / CLOCKS_PER_SEC);
+#endif
 }
 
-cv::Mat ThreshSaturation(cv::Mat src, double thresh) {
-  cv::cvtColor(src, src, cv::COLOR_BGR2HSV_FULL);
+}  // namespace
 
-  std::vector<cv::Mat> hsv_channels;
-  cv::split(src, hsv_channels);
+ExecutorScope::ExecutorScope(Executor* executor, int threads) noexcept : prev_executor_(current_executor), prev_threads_(current_threads) {
+  if (executor != nullptr) {
+    current_executor = executor;
+  }
+  if (threads > 0) {
+    current_threads = threads;
+  }
+}
 
-  cv::threshold(hsv_channels[1], hsv_channels[1], thresh, 0.0, cv::THRESH_TOZERO);
+ExecutorScope::~ExecutorScope() {
+  current_executor = prev_executor_;
+  current_threads = prev_threads_;
+}
 
-  cv::merge(hsv_channels, src);
+CpuTimer::CpuTimer() noexcept : prev_stripes_ns_(current_stripes_ns), start_ns_(GetThreadCpuNs()) {
+#ifdef CLOCK_THREAD_CPUTIME_ID
+  current_stripes_ns = &stripes_ns_;
+#endif
+}
 
-  cv::cvtColor(src, src, cv::COLOR_HSV2BGR_FULL);
+CpuTimer::~CpuTimer() {
+  current_stripes_ns = prev_stripes_ns_;
+}
 
-  return src;
+long long CpuTimer::GetElapsedNs() const noexcept {
+  return GetThreadCpuNs() - start_ns_ + stripes_ns_.load();
 }
 
-cv::Mat ThreshLightness(cv::Mat src, double thresh) {
-  cv::cvtColor(src, src, cv::COLOR_BGR2HLS_FULL);
+int CountThreads() {
+  Executor* executor = GetExecutor();
+  int threads = executor != nullptr ? executor->CountThreads() : cv::getNumThreads();
 
-  std::vector<cv::Mat> hls_channels;
-  cv::split(src, hls_channels);
+  return current_threads > 0 ? std::min(threads, current_threads) : threads;
+}
 
-  cv::threshold(hls_channels[1], hls_channels[1], thresh, 0.0, cv::THRESH_TOZERO);
+void ParallelFor(const cv::Range& range, const std::function<void(const cv::Range&)>& body) {
+  std::function<void(const cv::Range&)> traced_body;
+  if (IsTracing()) {
+    traced_body = [&body, stage = GetTraceStage()](const cv::Range& subrange) {
+      auto start = std::chrono::steady_clock::now();
+      body(subrange);
+      RecordTraceEvent(stage, start, std::chrono::steady_clock::now());
+    };
+  }
 
-  cv::merge(hls_channels, src);
+  std::function<void(const cv::Range&)> timed_body;
+  if (current_stripes_ns != nullptr && current_threads != 1) {
+    timed_body = [&body = traced_body ? traced_body : body, stripes_ns = current_stripes_ns, caller = std::this_thread::get_id()](const cv::Range& subrange) {
+      if (std::this_thread::get_id() == caller) {
+        body(subrange);
+        return;
+      }
 
-  cv::cvtColor(src, src, cv::COLOR_HLS2BGR_FULL);
+      CpuTimer stripe_timer;
+      body(subrange);
+      *stripes_ns += stripe_timer.GetElapsedNs();
+    };
+  }
+  const auto& stripe_body = timed_body ? timed_body : traced_body ? traced_body : body;
+
+  Executor* executor = GetExecutor();
+  if (current_threads == 1) {
+    stripe_body(range);
+  } else if (executor != nullptr) {
+    executor->ParallelFor(range, stripe_body, current_threads);
+  } else {
+    cv::parallel_for_(range, stripe_body, current_threads > 0 ? current_threads : 4.0 * cv::getNumThreads());
+  }
+}
 
-  return src;
+int CountChannels(PixelFormat format) {
+  return format == PixelFormat::kBgra || format == PixelFormat::kRgba ? 4 : 3;
 }
 
-std::map<std::array<int, 3>, int> ColorToN(const cv::Mat& src) {
-  std::map<std::array<int, 3>, int> rgb_to_n;
+std::array<int, 3> GetBgrOffsets(PixelFormat format) {
+  return format == PixelFormat::kRgb || format == PixelFormat::kRgba ? std::array<int, 3>{2, 1, 0} : std::array<int, 3>{0, 1, 2};
+}
+
+cv::Mat ImageViewToMat(const ImageView& view) {
+  if (view.data == nullptr || view.width <= 0 || view.height <= 0) {
+    throw std::invalid_argument("Image view must describe a non-empty buffer");
+  }
+
+  std::size_t row_bytes = static_cast<std::size_t>(view.width) * CountChannels(view.format);
+  if (view.stride != 0 && view.stride < row_bytes) {
+    throw std::invalid_argument("Image view stride must cover a row of the pixels");
+  }
 
-  for (const auto& [y, x] : std::views::cartesian_product(std::views::iota(0, src.rows), std::views::iota(0, src.cols))) {
-    const auto& pixel = src.at<cv::Vec3b>(y, x);
-    std::array<int, 3> rgb = {pixel[2], pixel[1], pixel[0]};
+  return cv::Mat(view.height, view.width, CV_8UC(CountChannels(view.format)), const_cast<unsigned char*>(view.data), view.stride != 0 ? view.stride : row_bytes);
+}
 
-    ++rgb_to_n[rgb];
+void ReleaseIfShared(cv::Mat& mat) noexcept {
+  if (mat.u == nullptr || mat.u->refcount > 1) {
+    mat.release();
   }
+}
+
+cv::Mat Preprocess(const cv::Mat& src, int ker_size, double saturation_thresh, double lightness_thresh, PixelFormat format) {
+  cv::Mat dst;
+  Preprocess(src, dst, ker_size, saturation_thresh, lightness_thresh, format);
+
+  return dst;
+}
+
+void Preprocess(const cv::Mat& src, cv::Mat& dst, int ker_size, double saturation_thresh, double lightness_thresh, PixelFormat format) {
+  const int kBlockRows = 8;
+
+  int to_hls_code = GetBgrOffsets(format)[0] == 0 ? cv::COLOR_BGR2HLS_FULL : cv::COLOR_RGB2HLS_FULL;
+
+  dst.create(src.rows, src.cols, CV_8UC3);
+
+  ParallelFor(cv::Range(0, (src.rows + kBlockRows - 1) / kBlockRows), [&](const cv::Range& range) {
+    cv::Mat smoothed_block;
+    cv::Mat smoothed_hls_block;
+    cv::Mat hls_block;
+    cv::Mat bgr_block;
+    cv::Mat hsv_block;
+
+    for (const auto& block : std::views::iota(range.start, range.end)) {
+      cv::Mat src_block = src.rowRange(block * kBlockRows, std::min((block + 1) * kBlockRows, src.rows));
+      cv::Mat dst_block = dst.rowRange(block * kBlockRows, std::min((block + 1) * kBlockRows, src.rows));
+
+      cv::GaussianBlur(src_block, smoothed_block, cv::Size(ker_size, ker_size), ker_size);
+
+      cv::cvtColor(src_block, hls_block, to_hls_code);
+      cv::cvtColor(smoothed_block, smoothed_hls_block, to_hls_code);
+
+      auto* hls = hls_block.ptr<cv::Vec3b>();
+      const auto* smoothed_hls = smoothed_hls_block.ptr<cv::Vec3b>();
+      for (const auto& i : std::views::iota(0uz, hls_block.total())) {
+        hls[i][0] = smoothed_hls[i][0];
+      }
+
+      cv::cvtColor(hls_block, bgr_block, cv::COLOR_HLS2BGR_FULL);
+      cv::cvtColor(bgr_block, hsv_block, cv::COLOR_BGR2HSV_FULL);
+
+      auto* hsv = hsv_block.ptr<cv::Vec3b>();
+      for (const auto& i : std::views::iota(0uz, hsv_block.total())) {
+        hsv[i][1] = hsv[i][1] > saturation_thresh ? hsv[i][1] : 0;
+      }
+
+      cv::cvtColor(hsv_block, bgr_block, cv::COLOR_HSV2BGR_FULL);
+      cv::cvtColor(bgr_block, hls_block, cv::COLOR_BGR2HLS_FULL);
+
+      hls = hls_block.ptr<cv::Vec3b>();
+      for (const auto& i : std::views::iota(0uz, hls_block.total())) {
+        hls[i][1] = hls[i][1] > lightness_thresh ? hls[i][1] : 0;
+      }
+
+      cv::cvtColor(hls_block, dst_block, cv::COLOR_HLS2BGR_FULL);
+    }
+  });
+}
+
+std::vector<std::pair<std::array<int, 3>, int>> ColorToN(const cv::Mat& src, PixelFormat format) {
+  std::vector<int> key_to_n(1 << 24, 0);
+  std::vector<int> keys;
+  std::vector<std::vector<std::pair<int, int>>> stripe_to_key_to_n;
+
+  AccumulateColorToN(src, key_to_n, keys, stripe_to_key_to_n, format);
+
+  std::vector<std::pair<std::array<int, 3>, int>> rgb_to_n;
+  CollectColorToN(keys, key_to_n, rgb_to_n);
 
   return rgb_to_n;
 }
 
+void AccumulateColorToN(const cv::Mat& src, std::vector<int>& key_to_n, std::vector<int>& keys, std::vector<std::vector<std::pair<int, int>>>& stripe_to_key_to_n, PixelFormat format) {
+  const std::size_t kMaxRuns = 1 << 12;
+  const int kStripes = std::clamp(CountThreads(), 1, std::max(src.rows, 1));
+
+  int cn = src.channels();
+  auto [b, g, r] = GetBgrOffsets(format);
+
+  stripe_to_key_to_n.resize(std::max(stripe_to_key_to_n.size(), static_cast<std::size_t>(kStripes)));
+  for (auto& stripe_key_to_n : stripe_to_key_to_n) {
+    stripe_key_to_n.clear();
+    stripe_key_to_n.reserve(kMaxRuns);
+  }
+
+  std::mutex keys_mutex;
+
+  ParallelFor(cv::Range(0, kStripes), [&](const cv::Range& range) {
+    std::vector<int> new_keys;
+
+    for (const auto& stripe : std::views::iota(range.start, range.end)) {
+      std::vector<std::pair<int, int>>& runs = stripe_to_key_to_n[stripe];
+
+      auto flush = [&] {
+        std::ranges::sort(runs, {}, &std::pair<int, int>::first);
+
+        for (auto it = runs.begin(); it != runs.end();) {
+          int key = it->first;
+          int n = 0;
+          for (; it != runs.end() && it->first == key; ++it) {
+            n += it->second;
+          }
+
+          if (std::atomic_ref(key_to_n[key]).fetch_add(n, std::memory_order_relaxed) == 0) {
+            new_keys.push_back(key);
+          }
+        }
+        runs.clear();
+
+        if (!new_keys.empty()) {
+          std::lock_guard lock(keys_mutex);
+          keys.insert(keys.end(), new_keys.begin(), new_keys.end());
+        }
+        new_keys.clear();
+      };
+
+      for (const auto& y : std::views::iota(src.rows * stripe / kStripes, src.rows * (stripe + 1) / kStripes)) {
+        const auto* row = src.ptr<uchar>(y);
+
+        for (const auto& x : std::views::iota(0, src.cols)) {
+          const uchar* px = row + x * cn;
+          int key = px[r] << 16 | px[g] << 8 | px[b];
+
+          if (!runs.empty() && runs.back().first == key) {
+            ++runs.back().second;
+            continue;
+          }
+
+          if (runs.size() == kMaxRuns) {
+            flush();
+          }
+          runs.emplace_back(key, 1);
+        }
+      }
+
+      flush();
+    }
+  });
+}
+
+void CollectColorToN(std::vector<int>& keys, std::vector<int>& key_to_n, std::vector<std::pair<std::array<int, 3>, int>>& rgb_to_n) {
+  std::ranges::sort(keys);
+
+  rgb_to_n.clear();
+  rgb_to_n.reserve(keys.size());
+
+  for (const auto& key : keys) {
+    rgb_to_n.emplace_back(std::array<int, 3>{key >> 16, key >> 8 & 0xFF, key & 0xFF}, std::exchange(key_to_n[key], 0));
+  }
+
+  keys.clear();
+}
+
+std::pair<cv::Mat, cv::Mat> ReadStrip(StripReader& reader, int y, int rows, const Params& params) {
+  const int kHalo = kSmoothKerSize / 2;
+
+  int height = reader.GetSize().height;
+  int halo_y = std::max(y - kHalo, 0);
+  int halo_rows = std::min(y + rows + kHalo, height) - halo_y;
+
+  cv::Mat src = reader.Read(halo_y, halo_rows);
+  cv::Mat processed_src = params.preprocessing ? Preprocess(src, kSmoothKerSize, params.saturation_thresh, params.lightness_thresh) : src;
+
+  cv::Range inner_rows(y - halo_y, y - halo_y + std::min(rows, height - y));
+
+  return {src.rowRange(inner_rows), processed_src.rowRange(inner_rows)};
+}
+
+cv::Mat SamplePixels(const cv::Mat& src, Sampling sampling, double density) {
+  density = std::clamp(density, 1e-6, 1.0);
+
+  if (sampling == Sampling::kStrided) {
+    int step = std::max(static_cast<int>(std::lround(1.0 / std::sqrt(density))), 1);
+    cv::Mat samples((src.rows + step - 1) / step, (src.cols + step - 1) / step, src.type());
+
+    ParallelFor(cv::Range(0, samples.rows), [&](const cv::Range& range) {
+      for (const auto& y : std::views::iota(range.start, range.end)) {
+        const auto* src_row = src.ptr<uchar>(y * step);
+        auto* samples_row = samples.ptr<uchar>(y);
+
+        for (const auto& x : std::views::iota(0, samples.cols)) {
+          std::copy_n(src_row + x * step * src.channels(), src.channels(), samples_row + x * src.channels());
+        }
+      }
+    });
+
+    return samples;
+  }
+
+  if (sampling == Sampling::kRandom) {
+    const int kBlockLen = 1 << 16;
+
+    int len = std::max(static_cast<int>(std::lround(density * static_cast<double>(src.total()))), 1);
+    cv::Mat samples(1, len, src.type());
+
+    ParallelFor(cv::Range(0, (len + kBlockLen - 1) / kBlockLen), [&](const cv::Range& range) {
+      for (const auto& block_idx : std::views::iota(range.start, range.end)) {
+        cv::RNG rng(0x9e3779b97f4a7c15ULL + block_idx);
+
+        for (const auto& i : std::views::iota(block_idx * kBlockLen, std::min((block_idx + 1) * kBlockLen, len))) {
+          int y = rng.uniform(0, src.rows);
+          int x = rng.uniform(0, src.cols);
+          std::copy_n(src.ptr<uchar>(y) + x * src.channels(), src.channels(), samples.ptr<uchar>() + i * src.channels());
+        }
+      }
+    });
+
+    return samples;
+  }
+
+  if (sampling == Sampling::kPyramid) {
+    cv::Mat samples = src;
+    for (double area = 1.0; area / 4.0 >= density && samples.rows > 1 && samples.cols > 1; area /= 4.0) {
+      cv::pyrDown(samples, samples);
+    }
+
+    return samples;
+  }
+
+  return src;
+}
+
+void ColorToLabel(const cv::Mat& src, cv::Mat& labels, std::vector<uchar>& rgb_to_label, const std::vector<int>& phi_to_label, PixelFormat format, double saturation_thresh, double lightness_thresh) {
+  labels.create(src.rows, src.cols, CV_8UC1);
+
+  int cn = src.channels();
+  auto [b, g, r] = GetBgrOffsets(format);
+
+  ParallelFor(cv::Range(0, src.rows), [&](const cv::Range& range) {
+    for (const auto& y : std::views::iota(range.start, range.end)) {
+      const auto* src_row = src.ptr<uchar>(y);
+      auto* labels_row = labels.ptr<uchar>(y);
+
+      for (const auto& x : std::views::iota(0, src.cols)) {
+        const uchar* px = src_row + x * cn;
+        std::atomic_ref label(rgb_to_label[px[r] << 16 | px[g] << 8 | px[b]]);
+
+        uchar known_label = label.load(std::memory_order_relaxed);
+        if (known_label == kUnknownLabel) {
+          int max_c = std::max({px[b], px[g], px[r]});
+          int min_c = std::min({px[b], px[g], px[r]});
+
+          bool is_achromatic = max_c == 0 || (max_c - min_c) * 255.0 / max_c <= saturation_thresh;
+          bool is_black = (is_achromatic ? max_c : (max_c + min_c) / 2) <= lightness_thresh;
+
+          cv::Vec3b bgr(px[b], px[g], px[r]);
+          std::array<int, 3> lab;
+          int phi = -1;
+          if (!is_achromatic && !is_black) {
+            ComputeLabPhi(&bgr, 1, &lab, &phi);
+          }
+
+          known_label = static_cast<uchar>(phi == -1 ? 0 : phi_to_label[phi]);
+          label.store(known_label, std::memory_order_relaxed);
+        }
+
+        labels_row[x] = known_label;
+      }
+    }
+  });
+}
+
+void ColorToLabel(const cv::Mat& src, cv::Mat& labels, const std::vector<uchar>& rgb_to_label, PixelFormat format) {
+  labels.create(src.rows, src.cols, CV_8UC1);
+
+  int cn = src.channels();
+  auto [b, g, r] = GetBgrOffsets(format);
+
+  ParallelFor(cv::Range(0, src.rows), [&](const cv::Range& range) {
+    for (const auto& y : std::views::iota(range.start, range.end)) {
+      const auto* src_row = src.ptr<uchar>(y);
+      auto* labels_row = labels.ptr<uchar>(y);
+
+      for (const auto& x : std::views::iota(0, src.cols)) {
+        const uchar* px = src_row + x * cn;
+        labels_row[x] = rgb_to_label[px[r] << 16 | px[g] << 8 | px[b]];
+      }
+    }
+  });
+}
+
+std::vector<cv::Mat> LabelToMasks(const cv::Mat& labels, int n) {
+  std::vector<cv::Mat> masks(n);
+  for (auto& mask : masks) {
+    mask = cv::Mat::zeros(labels.rows, labels.cols, CV_8UC1);
+  }
+
+  ParallelFor(cv::Range(0, labels.rows), [&](const cv::Range& range) {
+    std::vector<uchar*> mask_rows(masks.size());
+
+    for (const auto& y : std::views::iota(range.start, range.end)) {
+      const auto* labels_row = labels.ptr<uchar>(y);
+      std::ranges::transform(masks, mask_rows.begin(), [&y](cv::Mat& mask) { return mask.ptr<uchar>(y); });
+
+      for (const auto& x : std::views::iota(0, labels.cols)) {
+        mask_rows[labels_row[x]][x] = 255;
+      }
+    }
+  });
+
+  return masks;
+}
+
+cv::Mat LabelToLayer(const cv::Mat& src, const cv::Mat& labels, int label, PixelFormat format) {
+  cv::Mat layer(labels.rows, labels.cols, CV_8UC3);
+
+  int cn = src.channels();
+  auto [b, g, r] = GetBgrOffsets(format);
+
+  ParallelFor(cv::Range(0, labels.rows), [&](const cv::Range& range) {
+    for (const auto& y : std::views::iota(range.start, range.end)) {
+      const auto* src_row = src.ptr<uchar>(y);
+      const auto* labels_row = labels.ptr<uchar>(y);
+      auto* layer_row = layer.ptr<cv::Vec3b>(y);
+
+      for (const auto& x : std::views::iota(0, labels.cols)) {
+        const uchar* px = src_row + x * cn;
+        layer_row[x] = labels_row[x] == label ? cv::Vec3b(px[b], px[g], px[r]) : cv::Vec3b(255, 255, 255);
+      }
+    }
+  });
+
+  return layer;
+}
+
+std::vector<cv::Mat> LabelToLayers(const cv::Mat& src, const cv::Mat& labels, int n, PixelFormat format) {
+  int cn = src.channels();
+  auto [b, g, r] = GetBgrOffsets(format);
+
+  std::vector<cv::Mat> layers(n);
+  for (auto& layer : layers) {
+    layer = cv::Mat(labels.rows, labels.cols, CV_8UC3, cv::Vec3b(255, 255, 255));
+  }
+
+  ParallelFor(cv::Range(0, labels.rows), [&](const cv::Range& range) {
+    std::vector<cv::Vec3b*> layer_rows(layers.size());
+
+    for (const auto& y : std::views::iota(range.start, range.end)) {
+      const auto* src_row = src.ptr<uchar>(y);
+      const auto* labels_row = labels.ptr<uchar>(y);
+      std::ranges::transform(layers, layer_rows.begin(), [&y](cv::Mat& layer) { return layer.ptr<cv::Vec3b>(y); });
+
+      for (const auto& x : std::views::iota(0, labels.cols)) {
+        const uchar* px = src_row + x * cn;
+        layer_rows[labels_row[x]][x] = cv::Vec3b(px[b], px[g], px[r]);
+      }
+    }
+  });
+
+  return layers;
+}
+
+std::vector<SparseMask> LabelToSparseMasks(const cv::Mat& labels, int n) {
+  const int kStripes = std::clamp(CountThreads(), 1, std::max(labels.rows, 1));
+
+  std::vector<std::vector<std::vector<MaskRun>>> stripe_to_label_to_runs(kStripes, std::vector<std::vector<MaskRun>>(n));
+
+  ParallelFor(cv::Range(0, kStripes), [&](const cv::Range& range) {
+    for (const auto& stripe : std::views::iota(range.start, range.end)) {
+      std::vector<std::vector<MaskRun>>& label_to_runs = stripe_to_label_to_runs[stripe];
+
+      for (const auto& y : std::views::iota(labels.rows * stripe / kStripes, labels.rows * (stripe + 1) / kStripes)) {
+        const auto* labels_row = labels.ptr<uchar>(y);
+
+        for (int x = 0, len = 1; x < labels.cols; x += len, len = 1) {
+          while (x + len < labels.cols && labels_row[x + len] == labels_row[x]) {
+            ++len;
+          }
+          label_to_runs[labels_row[x]].push_back({y, x, len});
+        }
+      }
+    }
+  });
+
+  std::vector<SparseMask> masks;
+  masks.reserve(n);
+  for (const auto& label : std::views::iota(0, n)) {
+    std::vector<MaskRun> runs;
+    for (const auto& label_to_runs : stripe_to_label_to_runs) {
+      runs.insert(runs.end(), label_to_runs[label].begin(), label_to_runs[label].end());
+    }
+
+    masks.emplace_back(labels.size(), std::move(runs));
+  }
+
+  return masks;
+}
+
+std::vector<cv::Rect> LabelToBoxes(const cv::Mat& labels, int n) {
+  const int kStripes = std::clamp(CountThreads(), 1, std::max(labels.rows, 1));
+
+  std::vector<std::vector<std::array<int, 4>>> stripe_to_bounds(kStripes, std::vector<std::array<int, 4>>(n, {labels.cols, labels.rows, -1, -1}));
+
+  ParallelFor(cv::Range(0, kStripes), [&](const cv::Range& range) {
+    for (const auto& stripe : std::views::iota(range.start, range.end)) {
+      std::vector<std::array<int, 4>>& bounds = stripe_to_bounds[stripe];
+
+      for (const auto& y : std::views::iota(labels.rows * stripe / kStripes, labels.rows * (stripe + 1) / kStripes)) {
+        const auto* labels_row = labels.ptr<uchar>(y);
+
+        for (const auto& x : std::views::iota(0, labels.cols)) {
+          auto& [min_x, min_y, max_x, max_y] = bounds[labels_row[x]];
+          min_x = std::min(min_x, x);
+          min_y = std::min(min_y, y);
+          max_x = std::max(max_x, x);
+          max_y = std::max(max_y, y);
+        }
+      }
+    }
+  });
+
+  std::vector<cv::Rect> boxes(n);
+  for (const auto& [label, box] : boxes | std::views::enumerate) {
+    std::array<int, 4> merged = {labels.cols, labels.rows, -1, -1};
+    for (const auto& bounds : stripe_to_bounds) {
+      merged = {std::min(merged[0], bounds[label][0]), std::min(merged[1], bounds[label][1]), std::max(merged[2], bounds[label][2]), std::max(merged[3], bounds[label][3])};
+    }
+
+    if (merged[2] != -1) {
+      box = cv::Rect(cv::Point(merged[0], merged[1]), cv::Point(merged[2] + 1, merged[3] + 1));
+    }
+  }
+
+  return boxes;
+}
+
+cv::Mat LabelToCoverage(const cv::Mat& src, const cv::Mat& labels, int label, PixelFormat format) {
+  cv::Mat coverage(labels.rows, labels.cols, CV_8UC4);
+
+  int cn = src.channels();
+  auto [b, g, r] = GetBgrOffsets(format);
+
+  ParallelFor(cv::Range(0, labels.rows), [&](const cv::Range& range) {
+    for (const auto& y : std::views::iota(range.start, range.end)) {
+      const auto* src_row = src.ptr<uchar>(y);
+      const auto* labels_row = labels.ptr<uchar>(y);
+      auto* coverage_row = coverage.ptr<cv::Vec4b>(y);
+
+      for (const auto& x : std::views::iota(0, labels.cols)) {
+        const uchar* px = src_row + x * cn;
+        coverage_row[x] = labels_row[x] == label ? cv::Vec4b(px[b], px[g], px[r], 255) : cv::Vec4b(0, 0, 0, 0);
+      }
+    }
+  });
+
+  return coverage;
+}
+
 cv::Mat ProjOnPlane(const cv::Mat& point, const cv::Mat& center, const cv::Mat& norm, const cv::Mat& transform) {
   cv::Mat default_proj = (cv::Mat_<int>(1, 3) << 0, 0, 0);
   bool is_white = norm.dot(point - center) == 0.0;
@@ -92,6 +611,22 @@ cv::Mat ProjOnLab(cv::Mat rgb) {
   return proj;
 }
 
+void ProjColorOnLab(const std::array<int, 3>& rgb, std::array<int, 3>& lab, int& phi) {
+  const auto& [r, g, b] = rgb;
+
+  bool is_gray = r == g && g == b && r == b;
+  if (is_gray) {
+    lab = {0, 0, 0};
+    phi = -1;
+    return;
+  }
+
+  cv::Mat proj_lab = ProjOnLab((cv::Mat_<int>(1, 3) << r, g, b));
+
+  lab = {proj_lab.at<int>(0, 0), proj_lab.at<int>(0, 1), proj_lab.at<int>(0, 2)};
+  phi = RadToDeg(std::atan2(-lab[1], lab[0]));
+}
+
 int RadToDeg(double rad) {
   return std::lround(rad * 180.0 / std::numbers::pi + 360.0) % 360;
 }
@@ -122,6 +657,10 @@ std::vector<int> FindExtremes(const cv::Mat& histogram) {
   }
   std::ranges::sort(extremes);
 
+  if (extremes.size() < 2) {
+    return {};
+  }
+
   if (histogram.at<int>(extremes[0]) > histogram.at<int>(extremes[1])) {
     std::ranges::rotate(extremes, extremes.begin() + 1);
   }
@@ -146,30 +685,183 @@ std::vector<int> FindPeaks(const cv::Mat& histogram, int min_h) {
   return peaks;
 }
 
-double ComputeIou(const cv::Mat& predicted_mask, const cv::Mat& truth_mask) {
-  double intersection_area = cv::countNonZero(predicted_mask & truth_mask);
-  double union_area = cv::countNonZero(predicted_mask | truth_mask);
+cv::Mat SmoothHistogram(const cv::Mat& histogram, int ker_size) {
+  cv::Mat smoothed_histogram;
+  cv::hconcat(std::vector<cv::Mat>{histogram, histogram, histogram}, smoothed_histogram);
+
+  cv::GaussianBlur(smoothed_histogram, smoothed_histogram, cv::Size(ker_size, ker_size), 0.0);
+
+  smoothed_histogram = smoothed_histogram(cv::Rect(histogram.cols, 0, histogram.cols, 1));
+
+  smoothed_histogram.convertTo(smoothed_histogram, CV_32SC1);
+
+  return smoothed_histogram;
+}
+
+std::vector<int> FindClusters(const cv::Mat& smoothed_histogram, double peak_factor) {
+  std::vector<int> clusters;
+
+  double max_h;
+  cv::minMaxLoc(smoothed_histogram, nullptr, &max_h, nullptr, nullptr);
+  int round_max_h = std::lround(peak_factor * max_h);
+
+  std::vector<int> peaks = FindPeaks(smoothed_histogram, round_max_h);
+  if (peaks.empty()) {
+    peaks.push_back(0);
+  }
+  peaks.push_back(peaks[0] + 360);
+
+  std::transform(peaks.begin(), peaks.end() - 1, peaks.begin() + 1, std::back_inserter(clusters), [](int a, int b) { return (a + b) / 2 % 360; });
+  std::ranges::sort(clusters);
+
+  return clusters;
+}
+
+std::vector<int> MapPhiToCluster(const std::vector<int>& clusters) {
+  std::vector<int> phi_to_cluster(360, 1);
+
+  for (const auto& cluster_idx : std::views::iota(1uz, std::max(clusters.size(), 1uz))) {
+    auto l = phi_to_cluster.begin() + clusters[cluster_idx - 1];
+    auto r = phi_to_cluster.begin() + clusters[cluster_idx];
+
+    std::ranges::fill(l, r, static_cast<int>(cluster_idx) + 1);
+  }
+
+  return phi_to_cluster;
+}
+
+bool AreValidClusters(const std::vector<int>& clusters) {
+  return !clusters.empty() && clusters.size() <= kMaxClusters && clusters.front() >= 0 && clusters.back() < 360 &&
+         std::ranges::adjacent_find(clusters, std::greater_equal{}) == clusters.end();
+}
+
+double ComputePq(const cv::Mat& labels, int n, const std::vector<cv::Mat>& truth_masks) {
+  for (const auto& truth_mask : truth_masks) {
+    CV_Assert(truth_mask.type() == CV_8UC1 && truth_mask.size() == labels.size());
+  }
+
+  std::size_t m = truth_masks.size();
+
+  std::vector<long long> intersections(n * m, 0);
+  std::vector<long long> predicted_areas(n, 0);
+  std::vector<long long> truth_areas(m, 0);
+  std::mutex mutex;
+
+  ParallelFor(cv::Range(0, labels.rows), [&](const cv::Range& range) {
+    std::vector<long long> local_intersections(n * m, 0);
+    std::vector<long long> local_predicted_areas(n, 0);
+    std::vector<long long> local_truth_areas(m, 0);
+    std::vector<const uchar*> truth_rows(m);
+
+    for (const auto& y : std::views::iota(range.start, range.end)) {
+      const auto* labels_row = labels.ptr<uchar>(y);
+      std::ranges::transform(truth_masks, truth_rows.begin(), [&y](const cv::Mat& truth_mask) { return truth_mask.ptr<uchar>(y); });
+
+      for (const auto& x : std::views::iota(0, labels.cols)) {
+        int label = labels_row[x];
+        ++local_predicted_areas[label];
+
+        for (const auto& truth_idx : std::views::iota(0uz, m)) {
+          if (truth_rows[truth_idx][x] != 0) {
+            ++local_truth_areas[truth_idx];
+            ++local_intersections[label * m + truth_idx];
+          }
+        }
+      }
+    }
+
+    std::lock_guard lock(mutex);
+    std::ranges::transform(intersections, local_intersections, intersections.begin(), std::plus{});
+    std::ranges::transform(predicted_areas, local_predicted_areas, predicted_areas.begin(), std::plus{});
+    std::ranges::transform(truth_areas, local_truth_areas, truth_areas.begin(), std::plus{});
+  });
+
+  return MatchPq(intersections, predicted_areas, truth_areas);
+}
+
+double ComputePq(const cv::Mat& labels, int n, const cv::Mat& truth_labels) {
+  CV_Assert(truth_labels.type() == CV_8UC1 && truth_labels.size() == labels.size());
+
+  const std::size_t kMaxTruthLabels = 256;
+
+  std::vector<long long> intersections(n * kMaxTruthLabels, 0);
+  std::vector<long long> predicted_areas(n, 0);
+  std::vector<long long> truth_areas(kMaxTruthLabels, 0);
+  std::mutex mutex;
+
+  ParallelFor(cv::Range(0, labels.rows), [&](const cv::Range& range) {
+    std::vector<long long> local_intersections(n * kMaxTruthLabels, 0);
+
+    for (const auto& y : std::views::iota(range.start, range.end)) {
+      const auto* labels_row = labels.ptr<uchar>(y);
+      const auto* truth_labels_row = truth_labels.ptr<uchar>(y);
+
+      for (const auto& x : std::views::iota(0, labels.cols)) {
+        ++local_intersections[labels_row[x] * kMaxTruthLabels + truth_labels_row[x]];
+      }
+    }
+
+    std::lock_guard lock(mutex);
+    std::ranges::transform(intersections, local_intersections, intersections.begin(), std::plus{});
+  });
+
+  for (const auto& [label, truth_label] : std::views::cartesian_product(std::views::iota(0uz, static_cast<std::size_t>(n)), std::views::iota(0uz, kMaxTruthLabels))) {
+    predicted_areas[label] += intersections[label * kMaxTruthLabels + truth_label];
+    truth_areas[truth_label] += intersections[label * kMaxTruthLabels + truth_label];
+  }
+
+  std::vector<std::size_t> present_truth_labels;
+  std::ranges::copy_if(std::views::iota(0uz, kMaxTruthLabels), std::back_inserter(present_truth_labels), [&truth_areas](std::size_t truth_label) { return truth_areas[truth_label] > 0; });
+
+  std::vector<long long> present_intersections;
+  for (const auto& [label, truth_label] : std::views::cartesian_product(std::views::iota(0uz, static_cast<std::size_t>(n)), present_truth_labels)) {
+    present_intersections.push_back(intersections[label * kMaxTruthLabels + truth_label]);
+  }
+
+  std::vector<long long> present_truth_areas;
+  std::ranges::transform(present_truth_labels, std::back_inserter(present_truth_areas), [&truth_areas](std::size_t truth_label) { return truth_areas[truth_label]; });
+
+  return MatchPq(present_intersections, predicted_areas, present_truth_areas);
+}
+
+double ComputePq(const std::vector<SparseMask>& masks, const std::vector<SparseMask>& truth_masks) {
+  std::size_t m = truth_masks.size();
+
+  std::vector<long long> intersections(masks.size() * m, 0);
+  std::vector<long long> predicted_areas(masks.size(), 0);
+  std::vector<long long> truth_areas(m, 0);
+
+  std::ranges::transform(masks, predicted_areas.begin(), &SparseMask::CountArea);
+  std::ranges::transform(truth_masks, truth_areas.begin(), &SparseMask::CountArea);
+
+  ParallelFor(cv::Range(0, static_cast<int>(masks.size())), [&](const cv::Range& range) {
+    for (const auto& [label, truth_idx] : std::views::cartesian_product(std::views::iota(range.start, range.end), std::views::iota(0uz, m))) {
+      intersections[label * m + truth_idx] = masks[label].CountIntersection(truth_masks[truth_idx]);
+    }
+  });
 
-  return intersection_area / union_area;
+  return MatchPq(intersections, predicted_areas, truth_areas);
 }
 
-double ComputePq(const std::vector<cv::Mat>& predicted_masks, const std::vector<cv::Mat>& truth_masks) {
+double MatchPq(const std::vector<long long>& intersections, const std::vector<long long>& predicted_areas, const std::vector<long long>& truth_areas) {
   double sum_iou = 0.0;
   double tp = 0.0;
 
-  std::vector<bool> matched_predicted_masks(predicted_masks.size(), false);
-  std::vector<bool> matched_truth_masks(truth_masks.size(), false);
+  std::vector<bool> matched_predicted(predicted_areas.size(), false);
+  std::vector<bool> matched_truth(truth_areas.size(), false);
 
-  for (const auto& [predicted_mask_idx, predicted_mask] : predicted_masks | std::views::enumerate) {
+  for (const auto& [predicted_idx, predicted_area] : predicted_areas | std::views::enumerate) {
     double max_iou = 0.0;
     std::size_t max_iou_idx = -1;
 
-    for (const auto& [truth_mask_idx, truth_mask] : truth_masks | std::views::enumerate) {
-      double iou = ComputeIou(predicted_mask, truth_mask);
+    for (const auto& [truth_idx, truth_area] : truth_areas | std::views::enumerate) {
+      double intersection_area = static_cast<double>(intersections[predicted_idx * truth_areas.size() + truth_idx]);
+      double union_area = static_cast<double>(predicted_area + truth_area) - intersection_area;
+      double iou = intersection_area / union_area;
 
       if (iou >= max_iou) {
         max_iou = iou;
-        max_iou_idx = truth_mask_idx;
+        max_iou_idx = truth_idx;
       }
     }
 
@@ -177,13 +869,13 @@ double ComputePq(const std::vector<cv::Mat>& predicted_masks, const std::vector<
       sum_iou += max_iou;
       ++tp;
 
-      matched_predicted_masks[predicted_mask_idx] = true;
-      matched_truth_masks[max_iou_idx] = true;
+      matched_predicted[predicted_idx] = true;
+      matched_truth[max_iou_idx] = true;
     }
   }
 
-  double fp = static_cast<double>(std::ranges::count(matched_predicted_masks, false));
-  double fn = static_cast<double>(std::ranges::count(matched_truth_masks, false));
+  double fp = static_cast<double>(std::ranges::count(matched_predicted, false));
+  double fn = static_cast<double>(std::ranges::count(matched_truth, false));
 
   return sum_iou / (tp + 0.5 * (fp + fn));
 }
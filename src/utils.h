@@ -2,24 +2,91 @@
 #define UTILS_H_
 
 #include <array>
-#include <map>
+#include <atomic>
+#include <cstddef>
+#include <filesystem>
+#include <functional>
+#include <utility>
 #include <vector>
 
 #include <opencv2/core/core.hpp>
 
+#include "doc_color_decomposer/container.h"
+#include "doc_color_decomposer/image_view.h"
+#include "doc_color_decomposer/params.h"
+#include "doc_color_decomposer/sparse_mask.h"
+#include "doc_color_decomposer/strip_io.h"
+#include "doc_color_decomposer/thread_pool.h"
+
 namespace doc_color_decomposer {
 
-[[nodiscard]] cv::Mat SmoothHue(cv::Mat src, int ker_size = 5);
-[[nodiscard]] cv::Mat ThreshSaturation(cv::Mat src, double thresh = 10.0);
-[[nodiscard]] cv::Mat ThreshLightness(cv::Mat src, double thresh = 50.0);
-[[nodiscard]] std::map<std::array<int, 3>, int> ColorToN(const cv::Mat& src);
+const int kSmoothKerSize = 5;
+const uchar kUnknownLabel = 255;
+const std::size_t kMaxClusters = kUnknownLabel - 1;
+
+class [[nodiscard]] ExecutorScope final {
+ public:
+  explicit ExecutorScope(Executor* executor, int threads) noexcept;
+  ExecutorScope(const ExecutorScope&) = delete;
+  ExecutorScope& operator=(const ExecutorScope&) = delete;
+  ~ExecutorScope();
+
+ private:
+  Executor* prev_executor_;
+  int prev_threads_;
+};
+
+class [[nodiscard]] CpuTimer final {
+ public:
+  CpuTimer() noexcept;
+  CpuTimer(const CpuTimer&) = delete;
+  CpuTimer& operator=(const CpuTimer&) = delete;
+  ~CpuTimer();
+
+  [[nodiscard]] long long GetElapsedNs() const noexcept;
+
+ private:
+  std::atomic<long long> stripes_ns_ = 0;
+  std::atomic<long long>* prev_stripes_ns_;
+  long long start_ns_;
+};
+
+[[nodiscard]] int CountThreads();
+void ParallelFor(const cv::Range& range, const std::function<void(const cv::Range&)>& body);
+[[nodiscard]] int CountChannels(PixelFormat format);
+[[nodiscard]] std::array<int, 3> GetBgrOffsets(PixelFormat format);
+[[nodiscard]] cv::Mat ImageViewToMat(const ImageView& view);
+void ReleaseIfShared(cv::Mat& mat) noexcept;
+[[nodiscard]] cv::Mat Preprocess(const cv::Mat& src, int ker_size = kSmoothKerSize, double saturation_thresh = 10.0, double lightness_thresh = 50.0, PixelFormat format = PixelFormat::kBgr);
+void Preprocess(const cv::Mat& src, cv::Mat& dst, int ker_size, double saturation_thresh, double lightness_thresh, PixelFormat format);
+[[nodiscard]] std::vector<std::pair<std::array<int, 3>, int>> ColorToN(const cv::Mat& src, PixelFormat format = PixelFormat::kBgr);
+void AccumulateColorToN(const cv::Mat& src, std::vector<int>& key_to_n, std::vector<int>& keys, std::vector<std::vector<std::pair<int, int>>>& stripe_to_key_to_n, PixelFormat format = PixelFormat::kBgr);
+void CollectColorToN(std::vector<int>& keys, std::vector<int>& key_to_n, std::vector<std::pair<std::array<int, 3>, int>>& rgb_to_n);
+[[nodiscard]] std::pair<cv::Mat, cv::Mat> ReadStrip(StripReader& reader, int y, int rows, const Params& params);
+[[nodiscard]] cv::Mat SamplePixels(const cv::Mat& src, Sampling sampling, double density);
+void ColorToLabel(const cv::Mat& src, cv::Mat& labels, const std::vector<uchar>& rgb_to_label, PixelFormat format = PixelFormat::kBgr);
+void ColorToLabel(const cv::Mat& src, cv::Mat& labels, std::vector<uchar>& rgb_to_label, const std::vector<int>& phi_to_label, PixelFormat format = PixelFormat::kBgr, double saturation_thresh = -1.0, double lightness_thresh = -1.0);
+[[nodiscard]] std::vector<cv::Mat> LabelToMasks(const cv::Mat& labels, int n);
+[[nodiscard]] cv::Mat LabelToLayer(const cv::Mat& src, const cv::Mat& labels, int label, PixelFormat format = PixelFormat::kBgr);
+[[nodiscard]] std::vector<cv::Mat> LabelToLayers(const cv::Mat& src, const cv::Mat& labels, int n, PixelFormat format = PixelFormat::kBgr);
+[[nodiscard]] std::vector<SparseMask> LabelToSparseMasks(const cv::Mat& labels, int n);
+[[nodiscard]] std::vector<cv::Rect> LabelToBoxes(const cv::Mat& labels, int n);
+[[nodiscard]] cv::Mat LabelToCoverage(const cv::Mat& src, const cv::Mat& labels, int label, PixelFormat format = PixelFormat::kBgr);
+void WriteContainer(const std::filesystem::path& path, cv::Size size, const std::vector<ContainerLayer>& layers, const std::vector<std::vector<uchar>>& chunks);
 [[nodiscard]] cv::Mat ProjOnPlane(const cv::Mat& point, const cv::Mat& center, const cv::Mat& norm, const cv::Mat& transform);
 [[nodiscard]] cv::Mat ProjOnLab(cv::Mat rgb);
+void ProjColorOnLab(const std::array<int, 3>& rgb, std::array<int, 3>& lab, int& phi);
 [[nodiscard]] int RadToDeg(double rad);
 [[nodiscard]] std::vector<int> FindExtremes(const cv::Mat& histogram);
 [[nodiscard]] std::vector<int> FindPeaks(const cv::Mat& histogram, int min_h = 0);
-[[nodiscard]] double ComputeIou(const cv::Mat& predicted_mask, const cv::Mat& truth_mask);
-[[nodiscard]] double ComputePq(const std::vector<cv::Mat>& predicted_masks, const std::vector<cv::Mat>& truth_masks);
+[[nodiscard]] cv::Mat SmoothHistogram(const cv::Mat& histogram, int ker_size);
+[[nodiscard]] std::vector<int> FindClusters(const cv::Mat& smoothed_histogram, double peak_factor);
+[[nodiscard]] std::vector<int> MapPhiToCluster(const std::vector<int>& clusters);
+[[nodiscard]] bool AreValidClusters(const std::vector<int>& clusters);
+[[nodiscard]] double ComputePq(const cv::Mat& labels, int n, const std::vector<cv::Mat>& truth_masks);
+[[nodiscard]] double ComputePq(const cv::Mat& labels, int n, const cv::Mat& truth_labels);
+[[nodiscard]] double ComputePq(const std::vector<SparseMask>& masks, const std::vector<SparseMask>& truth_masks);
+[[nodiscard]] double MatchPq(const std::vector<long long>& intersections, const std::vector<long long>& predicted_areas, const std::vector<long long>& truth_areas);
 
 }  // namespace doc_color_decomposer
 
@@ -0,0 +1,30 @@
+#ifndef CHECK_H_
+#define CHECK_H_
+
+#include <cstdlib>
+#include <iostream>
+#include <string>
+
+namespace doc_color_decomposer {
+
+inline int failed_checks = 0;
+
+inline void Check(bool passed, const std::string& description) {
+  if (!passed) {
+    ++failed_checks;
+    std::cerr << "Failed: " << description << '\n';
+  }
+}
+
+inline int ReportChecks() {
+  if (failed_checks > 0) {
+    std::cerr << failed_checks << " checks failed\n";
+    return EXIT_FAILURE;
+  }
+
+  return EXIT_SUCCESS;
+}
+
+}  // namespace doc_color_decomposer
+
+#endif  // CHECK_H_
@@ -0,0 +1,170 @@
+#include <filesystem>
+#include <functional>
+#include <ranges>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <opencv2/core/core.hpp>
+
+#include "check.h"
+#include "doc_color_decomposer/cluster_model.h"
+#include "doc_color_decomposer/doc_color_decomposer.h"
+#include "document.h"
+
+namespace doc_color_decomposer {
+
+namespace {
+
+bool AreEqual(const cv::Mat& a, const cv::Mat& b) {
+  return a.size() == b.size() && a.type() == b.type() && cv::norm(a, b, cv::NORM_INF) == 0.0;
+}
+
+bool IsRejected(const std::filesystem::path& path, const ClusterModel& model) {
+  WriteClusterModel(path, model);
+
+  try {
+    static_cast<void>(ReadClusterModel(path));
+  } catch (const std::runtime_error&) {
+    return true;
+  }
+
+  return false;
+}
+
+bool IsRejected(const cv::Mat& src, const ClusterModel& model) {
+  try {
+    DocColorDecomposer dcd(src, model);
+  } catch (const std::invalid_argument&) {
+    return true;
+  }
+
+  return false;
+}
+
+void CheckRoundTrip(const std::filesystem::path& dir) {
+  cv::Mat src = MakeDocument();
+  DocColorDecomposer dcd(src, Params{.tolerance = 25, .saturation_thresh = 12.5, .peak_factor = 0.05});
+  ClusterModel model = dcd.ExportModel();
+
+  for (const auto& extension : {".yml", ".json", ".xml"}) {
+    std::filesystem::path path = dir / (std::string("model") + extension);
+    WriteClusterModel(path, model);
+    ClusterModel read_model = ReadClusterModel(path);
+
+    Check(read_model.clusters == model.clusters, std::string("clusters survive the ") + extension + " round trip");
+    Check(read_model.palette == model.palette, std::string("palette survives the ") + extension + " round trip");
+    Check(read_model.params == model.params, std::string("parameters survive the ") + extension + " round trip");
+  }
+
+  ClusterModel read_model = ReadClusterModel(dir / "model.yml");
+  DocColorDecomposer model_dcd(src, read_model);
+  Check(model_dcd.CountLayers() == dcd.CountLayers(), "model keeps the number of the layers");
+  Check(AreEqual(model_dcd.GetLabels(), dcd.GetLabels()), "model labels the document it was exported from identically");
+  Check(model_dcd.GetPalette() == dcd.GetPalette(), "model keeps the palette");
+
+  DocColorDecomposer reused_dcd(src, Params{.threads = 2});
+  reused_dcd.Decompose(src, read_model);
+  Check(reused_dcd.GetParams().threads == 2, "applying a model keeps the threads of the instance");
+  Check(reused_dcd.GetParams().tolerance == 25, "applying a model takes its tolerance");
+  Check(AreEqual(reused_dcd.GetLabels(), dcd.GetLabels()), "thresholded colors of the flat document get the labels of its smoothed colors");
+  Check(reused_dcd.MeasureDrift().max_boundary_shift == 0, "drift of the coarse-to-fine labeling is measured on the smoothed document");
+
+  ClusterModel threaded_model = read_model;
+  threaded_model.params.threads = 3;
+  DocColorDecomposer empty_dcd;
+  empty_dcd.Decompose(src, threaded_model);
+  Check(empty_dcd.GetParams().threads == 3, "empty instance takes the threads of the model");
+  Check(AreEqual(empty_dcd.GetLabels(), reused_dcd.GetLabels()), "empty instance labels the document like a reused one");
+
+  ClusterModel learned_model = DocColorDecomposer::LearnModel({src}, dcd.GetParams());
+  Check(learned_model.clusters == model.clusters, "model learned from a single page matches its decomposition");
+
+  bool retune_rejected = false;
+  try {
+    model_dcd.Retune(35);
+  } catch (const std::logic_error&) {
+    retune_rejected = true;
+  }
+  Check(retune_rejected, "instance with a model rejects retuning");
+
+  auto is_rejected = [](const std::function<void()>& run) {
+    try {
+      run();
+    } catch (const std::logic_error&) {
+      return true;
+    }
+
+    return false;
+  };
+  Check(is_rejected([&] { model_dcd.PrecomputeScaleSpace(35); }), "instance with a model rejects the scale space");
+  Check(is_rejected([&] { static_cast<void>(model_dcd.Plot1DPhi()); }), "instance with a model rejects the histogram plot");
+  Check(is_rejected([&] { static_cast<void>(model_dcd.Plot1DClusters()); }), "instance with a model rejects the clusters plot");
+  Check(is_rejected([&] { static_cast<void>(model_dcd.Plot3DRgb()); }), "instance with a model rejects the 3D plot");
+  Check(is_rejected([&] { static_cast<void>(model_dcd.Plot2DLab()); }), "instance with a model rejects the 2D plot");
+
+  std::ostringstream plot;
+  Check(is_rejected([&] { model_dcd.Plot1DPhi(plot); }) && plot.str().empty(), "instance with a model writes nothing into the sink");
+}
+
+void CheckRejectedModels(const std::filesystem::path& dir) {
+  cv::Mat src = MakeDocument();
+  ClusterModel model = DocColorDecomposer(src).ExportModel();
+
+  ClusterModel too_many = model;
+  too_many.clusters.clear();
+  for (const auto& phi : std::views::iota(0, 255)) {
+    too_many.clusters.push_back(phi);
+  }
+  too_many.palette.assign(too_many.clusters.size() + 1, {0, 0, 0});
+
+  ClusterModel duplicated = model;
+  duplicated.clusters = {30, 30, 200};
+  duplicated.palette.assign(duplicated.clusters.size() + 1, {0, 0, 0});
+
+  ClusterModel unsorted = model;
+  unsorted.clusters = {200, 30};
+  unsorted.palette.assign(unsorted.clusters.size() + 1, {0, 0, 0});
+
+  ClusterModel out_of_range = model;
+  out_of_range.clusters = {30, 360};
+  out_of_range.palette.assign(out_of_range.clusters.size() + 1, {0, 0, 0});
+
+  ClusterModel empty = model;
+  empty.clusters.clear();
+  empty.palette.assign(1, {0, 0, 0});
+
+  ClusterModel short_palette = model;
+  short_palette.palette.pop_back();
+
+  for (const auto& [invalid_model, description] : {std::pair{too_many, "255 clusters"}, std::pair{duplicated, "duplicate clusters"}, std::pair{unsorted, "unsorted clusters"},
+                                                   std::pair{out_of_range, "cluster out of range"}, std::pair{empty, "no clusters"}, std::pair{short_palette, "palette shorter than the layers"}}) {
+    Check(IsRejected(dir / "invalid.yml", invalid_model), std::string("reading a model with ") + description + " is rejected");
+    Check(IsRejected(src, invalid_model), std::string("applying a model with ") + description + " is rejected");
+  }
+
+  ClusterModel max_clusters = too_many;
+  max_clusters.clusters.pop_back();
+  max_clusters.palette.pop_back();
+  Check(!IsRejected(dir / "max.yml", max_clusters), "model with 254 clusters is accepted");
+
+  Check(IsRejected(dir / "missing.yml", ClusterModel()), "default model is rejected");
+}
+
+}  // namespace
+
+}  // namespace doc_color_decomposer
+
+int main() {
+  std::filesystem::path dir = std::filesystem::temp_directory_path() / "doc_color_decomposer_cluster_model_test";
+  std::filesystem::create_directories(dir);
+
+  doc_color_decomposer::CheckRoundTrip(dir);
+  doc_color_decomposer::CheckRejectedModels(dir);
+
+  std::filesystem::remove_all(dir);
+
+  return doc_color_decomposer::ReportChecks();
+}
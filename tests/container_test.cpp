@@ -0,0 +1,115 @@
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <ranges>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include <opencv2/core/core.hpp>
+
+#include "check.h"
+#include "doc_color_decomposer/container.h"
+#include "doc_color_decomposer/doc_color_decomposer.h"
+#include "document.h"
+
+namespace doc_color_decomposer {
+
+namespace {
+
+bool AreEqual(const cv::Mat& a, const cv::Mat& b) {
+  return a.size() == b.size() && a.type() == b.type() && cv::norm(a, b, cv::NORM_INF) == 0.0;
+}
+
+std::vector<char> ReadBytes(const std::filesystem::path& path) {
+  std::ifstream file(path, std::ios::binary);
+
+  return {std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>()};
+}
+
+void WriteBytes(const std::filesystem::path& path, const std::vector<char>& bytes) {
+  std::ofstream(path, std::ios::binary).write(bytes.data(), static_cast<std::streamsize>(bytes.size()));
+}
+
+bool IsRejected(const std::filesystem::path& path) {
+  try {
+    ContainerReader reader(path);
+    for (const auto& layer_idx : std::views::iota(0, reader.CountLayers())) {
+      static_cast<void>(reader.ReadMask(layer_idx));
+    }
+  } catch (const std::exception&) {
+    return true;
+  }
+
+  return false;
+}
+
+std::int64_t ReadLittleEndian(const std::vector<char>& bytes, std::size_t offset, std::size_t size) {
+  std::uint64_t bits = 0;
+  for (const auto& byte_idx : std::views::iota(0uz, size) | std::views::reverse) {
+    bits = bits << 8 | static_cast<unsigned char>(bytes[offset + byte_idx]);
+  }
+
+  return static_cast<std::int64_t>(bits);
+}
+
+void CheckRoundTrip(const std::filesystem::path& dir) {
+  cv::Mat src = MakeDocument();
+  DocColorDecomposer dcd(src, Params());
+
+  std::filesystem::path path = dir / "document.dcd";
+  dcd.WriteContainer(path);
+
+  ContainerReader reader(path);
+  Check(reader.GetSize() == src.size(), "container keeps the size of the document");
+  Check(reader.CountLayers() == dcd.CountLayers(), "container keeps the number of the layers");
+  Check(AreEqual(reader.ReadLabels(), dcd.GetLabels()), "container labels match the decomposition");
+
+  std::vector<std::array<int, 3>> palette = dcd.GetPalette();
+  std::vector<cv::Mat> masks = dcd.GetMasks();
+  for (const auto& layer_idx : std::views::iota(0, reader.CountLayers())) {
+    std::string layer = " of layer " + std::to_string(layer_idx);
+
+    Check(AreEqual(reader.ReadLayer(layer_idx), dcd.GetLayer(layer_idx)), "container pixels match the decomposition" + layer);
+    Check(AreEqual(reader.ReadMask(layer_idx), masks[layer_idx]), "container mask matches the decomposition" + layer);
+    Check(reader.GetLayerInfos()[layer_idx].mean_rgb == palette[layer_idx], "container color matches the palette" + layer);
+  }
+
+  std::vector<char> bytes = ReadBytes(path);
+  Check(bytes.size() >= 20 && std::string(bytes.data(), 4) == "DCDC", "container starts with the magic");
+  Check(bytes.size() >= 20 && ReadLittleEndian(bytes, 4, 4) == 1, "container version is little-endian");
+  Check(bytes.size() >= 20 && ReadLittleEndian(bytes, 8, 4) == src.cols && ReadLittleEndian(bytes, 12, 4) == src.rows, "container size is little-endian");
+  Check(bytes.size() >= 20 && ReadLittleEndian(bytes, 16, 4) == dcd.CountLayers(), "container number of the layers is little-endian");
+
+  std::vector<char> swapped = bytes;
+  std::ranges::reverse(swapped.begin() + 4, swapped.begin() + 8);
+  WriteBytes(dir / "swapped.dcd", swapped);
+  Check(IsRejected(dir / "swapped.dcd"), "container with a big-endian version is rejected");
+
+  std::vector<char> truncated(bytes.begin(), bytes.end() - 1);
+  WriteBytes(dir / "truncated.dcd", truncated);
+  Check(IsRejected(dir / "truncated.dcd"), "truncated container is rejected");
+
+  std::vector<char> bad_phi = bytes;
+  bad_phi[20 + 3] = 0x7F;
+  WriteBytes(dir / "bad-phi.dcd", bad_phi);
+  Check(IsRejected(dir / "bad-phi.dcd"), "container with an angle out of range is rejected");
+}
+
+}  // namespace
+
+}  // namespace doc_color_decomposer
+
+int main() {
+  std::filesystem::path dir = std::filesystem::temp_directory_path() / "doc_color_decomposer_container_test";
+  std::filesystem::create_directories(dir);
+
+  doc_color_decomposer::CheckRoundTrip(dir);
+
+  std::filesystem::remove_all(dir);
+
+  return doc_color_decomposer::ReportChecks();
+}
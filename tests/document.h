@@ -0,0 +1,22 @@
+#ifndef DOCUMENT_H_
+#define DOCUMENT_H_
+
+#include <opencv2/core/core.hpp>
+#include <opencv2/imgproc/imgproc.hpp>
+
+namespace doc_color_decomposer {
+
+inline cv::Mat MakeDocument() {
+  cv::Mat src(240, 320, CV_8UC3, cv::Scalar(255, 255, 255));
+
+  cv::rectangle(src, cv::Rect(20, 20, 120, 60), cv::Scalar(40, 40, 210), cv::FILLED);
+  cv::rectangle(src, cv::Rect(180, 20, 120, 60), cv::Scalar(200, 90, 20), cv::FILLED);
+  cv::rectangle(src, cv::Rect(20, 110, 280, 40), cv::Scalar(40, 170, 40), cv::FILLED);
+  cv::putText(src, "decomposer", cv::Point(30, 210), cv::FONT_HERSHEY_SIMPLEX, 1.5, cv::Scalar(20, 20, 20), 3);
+
+  return src;
+}
+
+}  // namespace doc_color_decomposer
+
+#endif  // DOCUMENT_H_
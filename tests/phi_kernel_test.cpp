@@ -0,0 +1,72 @@
+#include <array>
+#include <atomic>
+#include <ranges>
+#include <string>
+#include <vector>
+
+#include <opencv2/core/core.hpp>
+
+#include "check.h"
+#include "phi_kernel.h"
+#include "utils.h"
+
+namespace doc_color_decomposer {
+
+namespace {
+
+void CheckKernelsMatchReference(bool exhaustive) {
+  const int kRowStride = 31;
+
+  std::vector<std::pair<std::string, LabPhiKernel>> kernels = GetLabPhiKernels();
+  std::vector<std::atomic<long long>> kernel_to_mismatches(kernels.size());
+
+  std::vector<int> rgs;
+  for (const auto& rg : std::views::iota(0, 1 << 16)) {
+    if (exhaustive || rg % kRowStride == 0 || rg >> 8 == (rg & 255)) {
+      rgs.push_back(rg);
+    }
+  }
+
+  cv::parallel_for_(cv::Range(0, static_cast<int>(rgs.size())), [&](const cv::Range& range) {
+    std::vector<cv::Vec3b> bgr(256);
+    std::vector<std::array<int, 3>> reference_lab(256);
+    std::vector<int> reference_phi(256);
+    std::vector<std::array<int, 3>> lab(256);
+    std::vector<int> phi(256);
+
+    for (const auto& rg : rgs | std::views::drop(range.start) | std::views::take(range.size())) {
+      int r = rg >> 8;
+      int g = rg & 255;
+
+      for (const auto& b : std::views::iota(0, 256)) {
+        bgr[b] = cv::Vec3b(b, g, r);
+        ProjColorOnLab({r, g, b}, reference_lab[b], reference_phi[b]);
+      }
+
+      for (const auto& [kernel_idx, kernel] : kernels | std::views::values | std::views::enumerate) {
+        kernel(bgr.data(), 256, lab.data(), phi.data());
+
+        for (const auto& b : std::views::iota(0, 256)) {
+          if (lab[b] != reference_lab[b] || phi[b] != reference_phi[b]) {
+            kernel_to_mismatches[kernel_idx].fetch_add(1, std::memory_order_relaxed);
+          }
+        }
+      }
+    }
+  });
+
+  for (const auto& [kernel, mismatches] : std::views::zip(kernels, kernel_to_mismatches)) {
+    Check(mismatches == 0, kernel.first + " kernel differs from the reference engine on " + std::to_string(mismatches.load()) + " of " + std::to_string(rgs.size() * 256) + " colors");
+  }
+}
+
+}  // namespace
+
+}  // namespace doc_color_decomposer
+
+int main(int argc, char** argv) {
+  bool exhaustive = argc > 1 && std::string(argv[1]) == "--exhaustive";
+  doc_color_decomposer::CheckKernelsMatchReference(exhaustive);
+
+  return doc_color_decomposer::ReportChecks();
+}
@@ -0,0 +1,454 @@
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <exception>
+#include <iterator>
+#include <map>
+#include <optional>
+#include <ranges>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <tuple>
+#include <utility>
+#include <vector>
+
+#include <opencv2/core/core.hpp>
+#include <opencv2/imgproc/imgproc.hpp>
+
+#include "check.h"
+#include "doc_color_decomposer/batch.h"
+#include "doc_color_decomposer/doc_color_decomposer.h"
+#include "doc_color_decomposer/search.h"
+#include "doc_color_decomposer/thread_pool.h"
+#include "document.h"
+#include "utils.h"
+
+namespace doc_color_decomposer {
+
+namespace {
+
+cv::Mat MakeNoisyDocument() {
+  cv::Mat src = MakeDocument();
+  cv::Mat noise(src.size(), CV_8UC3);
+  cv::randu(noise, cv::Scalar::all(0), cv::Scalar::all(24));
+
+  return src - noise;
+}
+
+bool AreEqual(const cv::Mat& a, const cv::Mat& b) {
+  return a.size() == b.size() && a.type() == b.type() && cv::norm(a, b, cv::NORM_INF) == 0.0;
+}
+
+bool AreEqual(const std::vector<cv::Mat>& a, const std::vector<cv::Mat>& b) {
+  return std::ranges::equal(a, b, [](const cv::Mat& x, const cv::Mat& y) { return AreEqual(x, y); });
+}
+
+cv::Mat PreprocessByChannels(const cv::Mat& src, int ker_size, double saturation_thresh, double lightness_thresh) {
+  cv::Mat smoothed_src;
+  cv::GaussianBlur(src, smoothed_src, cv::Size(ker_size, ker_size), ker_size);
+
+  cv::Mat dst;
+  cv::cvtColor(src, dst, cv::COLOR_BGR2HLS_FULL);
+  cv::cvtColor(smoothed_src, smoothed_src, cv::COLOR_BGR2HLS_FULL);
+
+  const int kFromTo[] = {0, 0};
+  cv::mixChannels(&smoothed_src, 1, &dst, 1, kFromTo, 1);
+  cv::cvtColor(dst, dst, cv::COLOR_HLS2BGR_FULL);
+
+  std::vector<cv::Mat> channels;
+
+  cv::cvtColor(dst, dst, cv::COLOR_BGR2HSV_FULL);
+  cv::split(dst, channels);
+  cv::threshold(channels[1], channels[1], saturation_thresh, 0.0, cv::THRESH_TOZERO);
+  cv::merge(channels, dst);
+  cv::cvtColor(dst, dst, cv::COLOR_HSV2BGR_FULL);
+
+  cv::cvtColor(dst, dst, cv::COLOR_BGR2HLS_FULL);
+  cv::split(dst, channels);
+  cv::threshold(channels[1], channels[1], lightness_thresh, 0.0, cv::THRESH_TOZERO);
+  cv::merge(channels, dst);
+  cv::cvtColor(dst, dst, cv::COLOR_HLS2BGR_FULL);
+
+  return dst;
+}
+
+void CheckColorCounts() {
+  cv::Mat src = MakeNoisyDocument();
+
+  std::map<std::array<int, 3>, int> reference_rgb_to_n;
+  for (const auto& y : std::views::iota(0, src.rows)) {
+    for (const auto& x : std::views::iota(0, src.cols)) {
+      const auto& px = src.at<cv::Vec3b>(y, x);
+      ++reference_rgb_to_n[{px[2], px[1], px[0]}];
+    }
+  }
+
+  auto matches_reference = [&reference_rgb_to_n](std::vector<std::pair<std::array<int, 3>, int>> rgb_to_n) {
+    std::ranges::sort(rgb_to_n);
+    return std::ranges::equal(rgb_to_n, reference_rgb_to_n, [](const auto& a, const auto& b) { return a.first == b.first && a.second == b.second; });
+  };
+
+  Check(matches_reference(ColorToN(src)), "dense color counts match the ordered map");
+  Check(matches_reference(ColorToN(src.clone().reshape(3, 1))), "color counts of a single row match the ordered map");
+
+  cv::Mat rgb;
+  cv::cvtColor(src, rgb, cv::COLOR_BGR2RGB);
+  Check(matches_reference(ColorToN(rgb, PixelFormat::kRgb)), "color counts of the RGB order match the ordered map");
+}
+
+void CheckLabelViews() {
+  cv::Mat src = MakeNoisyDocument();
+  DocColorDecomposer dcd(src, Params());
+
+  cv::Mat labels = dcd.GetLabels();
+  int n = dcd.CountLayers();
+
+  double max_label;
+  cv::minMaxLoc(labels, nullptr, &max_label);
+  Check(labels.type() == CV_8UC1 && labels.size() == src.size(), "label image covers the document");
+  Check(n > 1 && max_label < n, "labels index the layers");
+
+  std::vector<cv::Mat> layers = dcd.GetLayers();
+  std::vector<cv::Mat> masks = dcd.GetMasks();
+  Check(std::ssize(layers) == n && std::ssize(masks) == n, "every layer and mask is derived");
+
+  cv::Mat coverage = cv::Mat::zeros(src.size(), CV_32SC1);
+  for (const auto& layer_idx : std::views::iota(0, std::min<int>(n, std::ssize(layers)))) {
+    std::string layer = " of layer " + std::to_string(layer_idx);
+
+    cv::Mat expected_mask = labels == layer_idx;
+    cv::Mat expected_layer(src.size(), CV_8UC3, cv::Scalar(255, 255, 255));
+    src.copyTo(expected_layer, expected_mask);
+
+    Check(AreEqual(masks[layer_idx], expected_mask), "mask selects the labels" + layer);
+    Check(AreEqual(layers[layer_idx], expected_layer), "layer keeps the colors of its labels" + layer);
+    Check(AreEqual(dcd.GetMask(layer_idx), expected_mask), "single mask matches the labels" + layer);
+    Check(AreEqual(dcd.GetLayer(layer_idx), expected_layer), "single layer matches the labels" + layer);
+
+    cv::add(coverage, masks[layer_idx] / 255, coverage, cv::noArray(), CV_32SC1);
+  }
+  Check(cv::countNonZero(coverage != 1) == 0, "masks partition the document");
+
+  Check(AreEqual(DocColorDecomposer(src, Params()).GetLayers(), layers), "layers of an expiring instance match");
+  Check(AreEqual(DocColorDecomposer(src, Params()).GetMasks(), masks), "masks of an expiring instance match");
+  Check(AreEqual(DocColorDecomposer(src, Params()).GetLabels(), labels), "labels of an expiring instance match");
+}
+
+void CheckRetune() {
+  cv::Mat src = MakeNoisyDocument();
+
+  auto matches_fresh = [&src](const DocColorDecomposer& dcd, int tolerance, double peak_factor) {
+    DocColorDecomposer fresh_dcd(src, Params{.tolerance = tolerance, .peak_factor = peak_factor});
+    return dcd.CountLayers() == fresh_dcd.CountLayers() && AreEqual(dcd.GetLabels(), fresh_dcd.GetLabels());
+  };
+
+  DocColorDecomposer dcd(src, Params());
+  for (const auto& tolerance : {15, 25, 45, 35}) {
+    dcd.Retune(tolerance);
+    Check(matches_fresh(dcd, tolerance, 0.025), "retuning to " + std::to_string(tolerance) + " matches a fresh decomposition");
+  }
+
+  dcd.PrecomputeScaleSpace(61);
+  for (const auto& tolerance : {1, 15, 61, 63}) {
+    dcd.Retune(tolerance);
+    Check(matches_fresh(dcd, tolerance, 0.025), "retuning to " + std::to_string(tolerance) + " with the scale space matches a fresh decomposition");
+  }
+
+  dcd.PrecomputeScaleSpace({15, 45}, 0.1);
+  for (const auto& [tolerance, peak_factor] : {std::pair{15, 0.1}, std::pair{45, 0.1}, std::pair{45, 0.025}, std::pair{25, 0.1}}) {
+    dcd.Retune(tolerance, peak_factor);
+    Check(matches_fresh(dcd, tolerance, peak_factor), "retuning to " + std::to_string(tolerance) + " and " + std::to_string(peak_factor) + " matches a fresh decomposition");
+  }
+
+  bool rejected = false;
+  try {
+    dcd.Retune(20);
+  } catch (const std::invalid_argument&) {
+    rejected = true;
+  }
+  Check(rejected, "retuning to an even tolerance is rejected");
+}
+
+void CheckImageViews() {
+  cv::Mat src = MakeNoisyDocument();
+  DocColorDecomposer dcd(src, Params());
+
+  for (const auto& [format, code, name] : {std::tuple{PixelFormat::kRgb, cv::COLOR_BGR2RGB, "RGB"}, std::tuple{PixelFormat::kBgra, cv::COLOR_BGR2BGRA, "BGRA"},
+                                           std::tuple{PixelFormat::kRgba, cv::COLOR_BGR2RGBA, "RGBA"}}) {
+    cv::Mat padded(src.rows, src.cols + 3, CV_8UC(format == PixelFormat::kRgb ? 3 : 4), cv::Scalar::all(0));
+    cv::Mat buffer = padded.colRange(0, src.cols);
+    cv::cvtColor(src, buffer, code);
+
+    ImageView view{.data = buffer.data, .width = buffer.cols, .height = buffer.rows, .stride = buffer.step, .format = format};
+    DocColorDecomposer view_dcd(view, Params());
+    Check(AreEqual(view_dcd.GetLabels(), dcd.GetLabels()), std::string("labels of a strided ") + name + " view match the BGR image");
+    Check(AreEqual(view_dcd.GetLayers(), dcd.GetLayers()), std::string("layers of a strided ") + name + " view match the BGR image");
+
+    DocColorDecomposer reused_dcd(src, Params());
+    reused_dcd.Decompose(view);
+    Check(AreEqual(reused_dcd.GetLabels(), dcd.GetLabels()), std::string("labels of a reused instance on a ") + name + " view match the BGR image");
+  }
+}
+
+void CheckSparseMasks() {
+  cv::Mat src = MakeNoisyDocument();
+  DocColorDecomposer dcd(src, Params());
+
+  std::vector<cv::Mat> masks = dcd.GetMasks();
+  std::vector<SparseMask> sparse_masks = dcd.GetSparseMasks();
+  Check(sparse_masks.size() == masks.size(), "sparse mask per layer");
+
+  for (const auto& [layer_idx, mask, sparse_mask] : std::views::zip(std::views::iota(0), masks, sparse_masks)) {
+    std::string layer = " of layer " + std::to_string(layer_idx);
+
+    Check(AreEqual(sparse_mask.Rasterize(), mask), "sparse mask rasterizes to the dense one" + layer);
+    Check(sparse_mask.GetBox() == cv::boundingRect(mask), "sparse mask bounds its pixels" + layer);
+    Check(sparse_mask.CountArea() == cv::countNonZero(mask), "sparse mask counts its pixels" + layer);
+    Check(AreEqual(sparse_mask.Rasterize(cv::Rect(10, 15, 100, 50)), mask(cv::Rect(10, 15, 100, 50))), "sparse mask rasterizes a region" + layer);
+
+    std::stringstream stream;
+    sparse_mask.Write(stream);
+    Check(AreEqual(SparseMask::Read(stream).Rasterize(), mask), "sparse mask survives serialization" + layer);
+
+    for (const auto& [other_mask, other_sparse_mask] : std::views::zip(masks, sparse_masks)) {
+      Check(sparse_mask.CountIntersection(other_sparse_mask) == cv::countNonZero(mask & other_mask), "sparse intersection matches the dense one" + layer);
+    }
+  }
+
+  cv::Mat truth_labels = dcd.GetLabels() / 2;
+  std::vector<cv::Mat> truth_masks = LabelToMasks(truth_labels, 128);
+  std::erase_if(truth_masks, [](const cv::Mat& truth_mask) { return cv::countNonZero(truth_mask) == 0; });
+
+  std::vector<SparseMask> sparse_truth_masks;
+  for (const auto& truth_mask : truth_masks) {
+    sparse_truth_masks.emplace_back(truth_mask);
+  }
+
+  double pq = dcd.ComputeQuality(truth_masks);
+  Check(dcd.ComputeQuality(sparse_truth_masks) == pq, "quality of the sparse masks matches the dense masks");
+  Check(dcd.ComputeQuality(truth_labels) == pq, "quality of the truth labels matches the dense masks");
+}
+
+void CheckReuse() {
+  std::vector<cv::Mat> srcs = {MakeNoisyDocument(), MakeDocument(), MakeNoisyDocument()(cv::Rect(30, 40, 200, 150)), MakeNoisyDocument()};
+
+  for (const auto& params : {Params(), Params{.engine = Engine::kVectorized}, Params{.sampling = Sampling::kStrided}}) {
+    DocColorDecomposer dcd(srcs.front(), params);
+
+    for (const auto& [src_idx, src] : std::views::zip(std::views::iota(0), srcs)) {
+      dcd.Decompose(src);
+
+      DocColorDecomposer fresh_dcd(src, params);
+      Check(dcd.CountLayers() == fresh_dcd.CountLayers() && AreEqual(dcd.GetLabels(), fresh_dcd.GetLabels()), "reused instance matches a fresh one on document " + std::to_string(src_idx));
+      Check(AreEqual(dcd.GetLayers(), fresh_dcd.GetLayers()), "reused instance derives the layers of document " + std::to_string(src_idx));
+    }
+  }
+}
+
+void CheckThreads() {
+  cv::Mat src = MakeNoisyDocument();
+  DocColorDecomposer dcd(src, Params());
+
+  ThreadPool pool(3);
+  for (const auto& [params, description] : {std::pair{Params{.threads = 1}, "a single thread"}, std::pair{Params{.threads = 2}, "two threads"},
+                                            std::pair{Params{.executor = &pool}, "a supplied pool"}, std::pair{Params{.threads = 2, .executor = &pool}, "two threads of a supplied pool"}}) {
+    DocColorDecomposer threaded_dcd(src, params);
+    Check(AreEqual(threaded_dcd.GetLabels(), dcd.GetLabels()), std::string("labels with ") + description + " match the default threads");
+    Check(AreEqual(threaded_dcd.GetLayers(), dcd.GetLayers()), std::string("layers with ") + description + " match the default threads");
+    Check(threaded_dcd.ComputeQuality(dcd.GetLabels()) == dcd.ComputeQuality(dcd.GetLabels()), std::string("quality with ") + description + " matches the default threads");
+  }
+}
+
+void CheckBatch() {
+  std::vector<cv::Mat> srcs = {MakeNoisyDocument(), MakeDocument(), MakeNoisyDocument(), MakeNoisyDocument()(cv::Rect(30, 40, 200, 150)), MakeNoisyDocument()};
+  Params params{.tolerance = 25};
+  ThreadPool pool(3);
+
+  std::vector<DocColorDecomposer> dcds = DecomposeBatch(srcs, pool, params);
+  Check(dcds.size() == srcs.size(), "batch returns a decomposition per document");
+
+  std::vector<cv::Mat> completed_labels(srcs.size());
+  std::size_t next_src_idx = 0;
+  DecomposeBatch([&]() -> std::optional<cv::Mat> {
+    return next_src_idx < srcs.size() ? std::optional(srcs[next_src_idx++]) : std::nullopt;
+  }, [&](std::size_t src_idx, DocColorDecomposer&& dcd, std::exception_ptr error) {
+    if (!error) {
+      completed_labels[src_idx] = std::move(dcd).GetLabels();
+    }
+  }, pool, params);
+
+  for (const auto& [src_idx, src, dcd] : std::views::zip(std::views::iota(0), srcs, dcds)) {
+    DocColorDecomposer single_dcd(src, params);
+    Check(AreEqual(dcd.GetLabels(), single_dcd.GetLabels()), "batch matches a single decomposition of document " + std::to_string(src_idx));
+    Check(AreEqual(completed_labels[src_idx], single_dcd.GetLabels()), "produced batch matches a single decomposition of document " + std::to_string(src_idx));
+  }
+
+  std::atomic<long long> sum = 0;
+  pool.ParallelFor(cv::Range(0, 64), [&](const cv::Range& range) {
+    for (const auto& i : std::views::iota(range.start, range.end)) {
+      pool.ParallelFor(cv::Range(0, 1000), [&](const cv::Range& inner_range) {
+        long long local_sum = 0;
+        for (const auto& j : std::views::iota(inner_range.start, inner_range.end)) {
+          local_sum += i * j;
+        }
+        sum += local_sum;
+      });
+    }
+  });
+  Check(sum == 64LL * 63 / 2 * (1000LL * 999 / 2), "nested loops on the pool cover every iteration once");
+
+  bool rethrown = false;
+  try {
+    pool.ParallelFor(cv::Range(0, 16), [](const cv::Range& range) {
+      if (range.start <= 7 && 7 < range.end) {
+        throw std::runtime_error("stripe failed");
+      }
+    });
+  } catch (const std::runtime_error&) {
+    rethrown = true;
+  }
+  Check(rethrown, "exception of a stripe is rethrown by the loop");
+}
+
+void CheckSearch() {
+  std::vector<SearchSample> samples;
+  for (const auto& src : {MakeNoisyDocument(), MakeDocument()}) {
+    samples.push_back({.src = src, .truth_labels = DocColorDecomposer(src, Params{.tolerance = 25}).GetLabels()});
+  }
+  samples.push_back({.src = samples.front().src, .truth_masks = DocColorDecomposer(samples.front().src, Params()).GetMasks()});
+
+  SearchGrid grid{.tolerances = {15, 35, 45}, .peak_factors = {0.025, 0.1}, .thresholds = {{10.0, 50.0}, {20.0, 60.0}}};
+  ThreadPool pool(3);
+
+  std::vector<SearchResult> results = SearchParams(samples, grid, pool);
+  Check(results.size() == 12, "search evaluates every point of the grid");
+  Check(std::ranges::is_sorted(results, std::ranges::greater{}, &SearchResult::mean_pq), "search results are sorted by the mean quality");
+
+  for (const auto& result : results) {
+    std::string point = " at " + std::to_string(result.params.tolerance) + ", " + std::to_string(result.params.peak_factor) + ", " + std::to_string(result.params.saturation_thresh);
+
+    for (const auto& [sample, pq] : std::views::zip(samples, result.pqs)) {
+      DocColorDecomposer dcd(sample.src, result.params);
+      double expected_pq = sample.truth_labels.empty() ? dcd.ComputeQuality(sample.truth_masks) : dcd.ComputeQuality(sample.truth_labels);
+      Check(pq == expected_pq, "search quality matches a fresh decomposition" + point);
+    }
+  }
+}
+
+void CheckStats() {
+  cv::Mat src = MakeNoisyDocument();
+
+  std::atomic<bool> spinning = true;
+  std::thread spinner([&spinning] {
+    while (spinning) {
+    }
+  });
+
+  DocColorDecomposer dcd(src, Params{.threads = 1});
+  Stats stats = dcd.GetStats();
+
+  spinning = false;
+  spinner.join();
+
+  std::vector<std::string> stage_names;
+  std::ranges::transform(stats.stages, std::back_inserter(stage_names), &StageStats::name);
+  Check(stage_names == std::vector<std::string>{"Preprocess", "ColorToN", "ComputePhiHistogram", "ComputeSmoothedPhiHistogram", "ComputeClusters", "ComputeRgbToCluster", "ComputeLabels"},
+        "stats record every stage in order");
+
+  for (const auto& stage : stats.stages) {
+    Check(stage.wall_ms >= 0.0 && stage.cpu_ms >= 0.0, "times of " + stage.name + " are not negative");
+    Check(stage.cpu_ms <= stage.wall_ms + 1.0, "single-threaded " + stage.name + " is not charged with the CPU time of another thread");
+  }
+
+  Check(stats.pixels == static_cast<long long>(src.total()), "stats count the pixels");
+  Check(stats.clusters == dcd.CountLayers(), "stats count the layers");
+  Check(stats.colors == static_cast<int>(ColorToN(Preprocess(src)).size()), "stats count the colors of the preprocessed document");
+}
+
+void CheckPreprocess() {
+  std::vector<cv::Mat> srcs = {MakeNoisyDocument(), cv::Mat(37, 53, CV_8UC3), cv::Mat(1, 200, CV_8UC3), MakeNoisyDocument()(cv::Rect(3, 5, 301, 217))};
+  cv::randu(srcs[1], cv::Scalar::all(0), cv::Scalar::all(256));
+  cv::randu(srcs[2], cv::Scalar::all(0), cv::Scalar::all(256));
+
+  for (const auto& [src_idx, src] : std::views::zip(std::views::iota(0), srcs)) {
+    std::string image = " of image " + std::to_string(src_idx);
+
+    cv::Mat expected = PreprocessByChannels(src, kSmoothKerSize, 10.0, 50.0);
+    Check(AreEqual(Preprocess(src), expected), "fused preprocessing matches the channel-wise chain" + image);
+    Check(AreEqual(Preprocess(src, kSmoothKerSize, 25.0, 80.0), PreprocessByChannels(src, kSmoothKerSize, 25.0, 80.0)), "fused preprocessing matches the chain with other thresholds" + image);
+
+    cv::Mat rgb;
+    cv::cvtColor(src, rgb, cv::COLOR_BGR2RGB);
+    cv::Mat processed_rgb;
+    Preprocess(rgb, processed_rgb, kSmoothKerSize, 10.0, 50.0, PixelFormat::kRgb);
+    Check(AreEqual(processed_rgb, PreprocessByChannels(src.clone(), kSmoothKerSize, 10.0, 50.0)), "fused preprocessing of the RGB order matches the chain" + image);
+  }
+}
+
+void CheckSampling() {
+  cv::Mat src = MakeNoisyDocument();
+  DocColorDecomposer dcd(src, Params());
+
+  DocColorDecomposer dense_dcd(src, Params{.sampling = Sampling::kStrided, .sample_density = 1.0});
+  Check(AreEqual(dense_dcd.GetLabels(), dcd.GetLabels()), "strided sampling of every pixel matches the full histogram");
+
+  ClusterDrift dense_drift = dense_dcd.MeasureDrift();
+  Check(dense_drift.exact_layers == dense_drift.approximate_layers && dense_drift.max_boundary_shift == 0 && dense_drift.relabeled_fraction == 0.0,
+        "strided sampling of every pixel does not drift");
+
+  for (const auto& [sampling, name] : {std::pair{Sampling::kStrided, "strided"}, std::pair{Sampling::kRandom, "random"}, std::pair{Sampling::kPyramid, "pyramid"}}) {
+    DocColorDecomposer sampled_dcd(src, Params{.sampling = sampling, .sample_density = 0.1});
+
+    double max_label;
+    cv::minMaxLoc(sampled_dcd.GetLabels(), nullptr, &max_label);
+    Check(max_label < sampled_dcd.CountLayers(), std::string("labels of ") + name + " sampling index the layers");
+
+    ClusterDrift drift = sampled_dcd.MeasureDrift();
+    Check(drift.exact_layers == dcd.CountLayers() && drift.approximate_layers == sampled_dcd.CountLayers(), std::string("drift of ") + name + " sampling counts the layers");
+    Check(drift.relabeled_fraction >= 0.0 && drift.relabeled_fraction <= 1.0, std::string("drift of ") + name + " sampling is a fraction");
+  }
+}
+
+void CheckPlots() {
+  DocColorDecomposer dcd(MakeNoisyDocument(), Params());
+
+  std::ostringstream plot_3d_rgb;
+  dcd.Plot3DRgb(plot_3d_rgb, 120.0, 30.0, 5);
+  Check(plot_3d_rgb.str() == dcd.Plot3DRgb(120.0, 30.0, 5), "3D plot written into a sink matches the string");
+
+  std::ostringstream plot_1d_phi;
+  dcd.Plot1DPhi(plot_1d_phi);
+  Check(plot_1d_phi.str() == dcd.Plot1DPhi(), "1D plot written into a sink matches the string");
+
+  std::ostringstream plot_1d_clusters;
+  dcd.Plot1DClusters(plot_1d_clusters);
+  Check(plot_1d_clusters.str() == dcd.Plot1DClusters(), "clusters plot written into a sink matches the string");
+
+  cv::Mat plot_2d_lab = dcd.Plot2DLab();
+  Check(!plot_2d_lab.empty() && AreEqual(dcd.Plot2DLab(), plot_2d_lab), "2D plot with the cached background is stable");
+}
+
+}  // namespace
+
+}  // namespace doc_color_decomposer
+
+int main() {
+  doc_color_decomposer::CheckColorCounts();
+  doc_color_decomposer::CheckPreprocess();
+  doc_color_decomposer::CheckLabelViews();
+  doc_color_decomposer::CheckRetune();
+  doc_color_decomposer::CheckImageViews();
+  doc_color_decomposer::CheckSparseMasks();
+  doc_color_decomposer::CheckReuse();
+  doc_color_decomposer::CheckThreads();
+  doc_color_decomposer::CheckBatch();
+  doc_color_decomposer::CheckSearch();
+  doc_color_decomposer::CheckStats();
+  doc_color_decomposer::CheckSampling();
+  doc_color_decomposer::CheckPlots();
+
+  return doc_color_decomposer::ReportChecks();
+}
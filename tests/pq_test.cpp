@@ -0,0 +1,158 @@
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <random>
+#include <ranges>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <opencv2/core/core.hpp>
+
+#include "check.h"
+#include "doc_color_decomposer/sparse_mask.h"
+#include "utils.h"
+
+namespace doc_color_decomposer {
+
+namespace {
+
+double ComputeMaskPq(const std::vector<cv::Mat>& predicted_masks, const std::vector<cv::Mat>& truth_masks) {
+  double sum_iou = 0.0;
+  double tp = 0.0;
+
+  std::vector<bool> matched_predicted_masks(predicted_masks.size(), false);
+  std::vector<bool> matched_truth_masks(truth_masks.size(), false);
+
+  for (const auto& [predicted_mask_idx, predicted_mask] : predicted_masks | std::views::enumerate) {
+    double max_iou = 0.0;
+    std::size_t max_iou_idx = -1;
+
+    for (const auto& [truth_mask_idx, truth_mask] : truth_masks | std::views::enumerate) {
+      double iou = cv::countNonZero(predicted_mask & truth_mask) / static_cast<double>(cv::countNonZero(predicted_mask | truth_mask));
+
+      if (iou >= max_iou) {
+        max_iou = iou;
+        max_iou_idx = truth_mask_idx;
+      }
+    }
+
+    if (max_iou >= 0.5) {
+      sum_iou += max_iou;
+      ++tp;
+
+      matched_predicted_masks[predicted_mask_idx] = true;
+      matched_truth_masks[max_iou_idx] = true;
+    }
+  }
+
+  double fp = static_cast<double>(std::ranges::count(matched_predicted_masks, false));
+  double fn = static_cast<double>(std::ranges::count(matched_truth_masks, false));
+
+  return sum_iou / (tp + 0.5 * (fp + fn));
+}
+
+std::vector<cv::Mat> PresentLabelToMasks(const cv::Mat& labels) {
+  std::vector<cv::Mat> masks;
+  for (const auto& mask : LabelToMasks(labels, 256)) {
+    if (cv::countNonZero(mask) > 0) {
+      masks.push_back(mask);
+    }
+  }
+
+  return masks;
+}
+
+std::vector<SparseMask> ToSparseMasks(const std::vector<cv::Mat>& masks) {
+  std::vector<SparseMask> sparse_masks;
+  for (const auto& mask : masks) {
+    sparse_masks.emplace_back(mask);
+  }
+
+  return sparse_masks;
+}
+
+void CheckPq(const cv::Mat& labels, int n, const cv::Mat& truth_labels, double expected_pq, const std::string& description) {
+  std::vector<cv::Mat> masks = LabelToMasks(labels, n);
+  std::vector<cv::Mat> truth_masks = PresentLabelToMasks(truth_labels);
+
+  const double kEps = 1e-12;
+  Check(std::abs(ComputePq(labels, n, truth_masks) - expected_pq) < kEps, description + " from the truth masks");
+  Check(std::abs(ComputePq(labels, n, truth_labels) - expected_pq) < kEps, description + " from the truth labels");
+  Check(std::abs(ComputePq(ToSparseMasks(masks), ToSparseMasks(truth_masks)) - expected_pq) < kEps, description + " from the sparse masks");
+}
+
+void CheckKnownValues() {
+  cv::Mat labels(10, 10, CV_8UC1, cv::Scalar(0));
+  labels.colRange(5, 10).setTo(1);
+
+  CheckPq(labels, 2, labels, 1.0, "PQ of the identical segmentations is 1");
+
+  cv::Mat truth_labels(10, 10, CV_8UC1, cv::Scalar(3));
+  truth_labels.colRange(6, 10).setTo(7);
+  CheckPq(labels, 2, truth_labels, (5.0 / 6.0 + 4.0 / 5.0) / 2.0, "PQ of the shifted boundary is the mean IoU");
+
+  truth_labels.colRange(0, 2).setTo(9);
+  CheckPq(labels, 2, truth_labels, (0.5 + 4.0 / 5.0) / 2.5, "PQ with an unmatched truth segment counts a false negative");
+
+  cv::Mat single_labels(10, 10, CV_8UC1, cv::Scalar(0));
+  CheckPq(single_labels, 2, labels, 0.5 / 2.0, "PQ with an empty predicted layer");
+}
+
+void CheckRandomValues() {
+  std::mt19937 rng(7);
+  std::uniform_int_distribution<int> label_dist(0, 5);
+  std::uniform_real_distribution<double> noise_dist(0.0, 1.0);
+
+  for (const auto& trial : std::views::iota(0, 20)) {
+    cv::Mat truth_labels(64 + trial, 48, CV_8UC1);
+    for (const auto& y : std::views::iota(0, truth_labels.rows)) {
+      for (const auto& x : std::views::iota(0, truth_labels.cols)) {
+        truth_labels.at<uchar>(y, x) = static_cast<uchar>(10 * ((x / 12 + y / 16) % 4));
+      }
+    }
+
+    cv::Mat labels(truth_labels.size(), CV_8UC1);
+    for (const auto& y : std::views::iota(0, labels.rows)) {
+      for (const auto& x : std::views::iota(0, labels.cols)) {
+        labels.at<uchar>(y, x) = static_cast<uchar>(noise_dist(rng) < 0.05 * trial ? label_dist(rng) : truth_labels.at<uchar>(y, x) / 10);
+      }
+    }
+
+    CheckPq(labels, 6, truth_labels, ComputeMaskPq(LabelToMasks(labels, 6), PresentLabelToMasks(truth_labels)), "PQ matches the pairwise mask IoUs in trial " + std::to_string(trial));
+  }
+}
+
+void CheckRejectedTruth() {
+  cv::Mat labels(10, 10, CV_8UC1, cv::Scalar(0));
+
+  for (const auto& [truth, description] : {std::pair{cv::Mat(10, 11, CV_8UC1, cv::Scalar(0)), "truth of another size"}, std::pair{cv::Mat(10, 10, CV_16UC1, cv::Scalar(0)), "truth of another type"}}) {
+    bool labels_rejected = false;
+    try {
+      static_cast<void>(ComputePq(labels, 1, truth));
+    } catch (const cv::Exception&) {
+      labels_rejected = true;
+    }
+    Check(labels_rejected, std::string("truth labels rejected for ") + description);
+
+    bool masks_rejected = false;
+    try {
+      static_cast<void>(ComputePq(labels, 1, std::vector<cv::Mat>{truth}));
+    } catch (const cv::Exception&) {
+      masks_rejected = true;
+    }
+    Check(masks_rejected, std::string("truth masks rejected for ") + description);
+  }
+}
+
+}  // namespace
+
+}  // namespace doc_color_decomposer
+
+int main() {
+  doc_color_decomposer::CheckKnownValues();
+  doc_color_decomposer::CheckRandomValues();
+  doc_color_decomposer::CheckRejectedTruth();
+
+  return doc_color_decomposer::ReportChecks();
+}
@@ -0,0 +1,146 @@
+#include <algorithm>
+#include <filesystem>
+#include <fstream>
+#include <memory>
+#include <ranges>
+#include <stdexcept>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <opencv2/core/core.hpp>
+
+#include "check.h"
+#include "doc_color_decomposer/doc_color_decomposer.h"
+#include "doc_color_decomposer/strip_io.h"
+#include "document.h"
+
+namespace doc_color_decomposer {
+
+namespace {
+
+class MatStripWriter final : public StripWriter {
+ public:
+  explicit MatStripWriter(cv::Mat& dst) : dst_(dst) {}
+
+  void Write(const cv::Mat& strip) override {
+    dst_.push_back(strip);
+  }
+
+ private:
+  cv::Mat& dst_;
+};
+
+bool AreEqual(const cv::Mat& a, const cv::Mat& b) {
+  return a.size() == b.size() && a.type() == b.type() && cv::norm(a, b, cv::NORM_INF) == 0.0;
+}
+
+bool IsRejected(const std::filesystem::path& path) {
+  try {
+    PnmStripReader reader(path);
+  } catch (const std::runtime_error&) {
+    return true;
+  }
+
+  return false;
+}
+
+void WritePpm(const std::filesystem::path& path, const std::string& header, const std::string& samples) {
+  std::ofstream(path, std::ios::binary) << header << samples;
+}
+
+void CheckRoundTrip(const std::filesystem::path& dir) {
+  cv::Mat src = MakeDocument();
+
+  {
+    PnmStripWriter writer(dir / "document.ppm", src.size(), 3);
+    for (const auto& y : std::views::iota(0, src.rows) | std::views::stride(100)) {
+      writer.Write(src.rowRange(y, std::min(y + 100, src.rows)));
+    }
+  }
+
+  PnmStripReader reader(dir / "document.ppm");
+  Check(reader.GetSize() == src.size(), "reader parses the size of the image");
+  Check(AreEqual(reader.Read(0, src.rows), src), "whole image is read back unchanged");
+  Check(AreEqual(reader.Read(src.rows - 7, 7), src.rowRange(src.rows - 7, src.rows)), "last strip is read back unchanged");
+
+  for (const auto& [y, rows] : {std::pair{-1, 1}, std::pair{0, 0}, std::pair{src.rows - 7, 8}, std::pair{src.rows, 1}}) {
+    bool rejected = false;
+    try {
+      static_cast<void>(reader.Read(y, rows));
+    } catch (const std::out_of_range&) {
+      rejected = true;
+    }
+    Check(rejected, "strip of " + std::to_string(rows) + " rows at " + std::to_string(y) + " is rejected");
+  }
+}
+
+void CheckMaxValue(const std::filesystem::path& dir) {
+  WritePpm(dir / "max-15.ppm", "P6\n# comment\n2 1\n15\n", std::string("\x0F\x07\x00\x00\x0F\x03", 6));
+
+  PnmStripReader reader(dir / "max-15.ppm");
+  cv::Mat strip = reader.Read(0, 1);
+  Check(strip.at<cv::Vec3b>(0, 0) == cv::Vec3b(0, 119, 255), "samples of a maximum value of 15 are rescaled");
+  Check(strip.at<cv::Vec3b>(0, 1) == cv::Vec3b(51, 255, 0), "samples of a maximum value of 15 are rescaled");
+
+  WritePpm(dir / "max-0.ppm", "P6 1 1 0\n", std::string(3, '\0'));
+  Check(IsRejected(dir / "max-0.ppm"), "maximum value of 0 is rejected");
+
+  WritePpm(dir / "max-65535.ppm", "P6 1 1 65535\n", std::string(6, '\0'));
+  Check(IsRejected(dir / "max-65535.ppm"), "16-bit samples are rejected");
+
+  WritePpm(dir / "p3.ppm", "P3 1 1 255\n", "0 0 0\n");
+  Check(IsRejected(dir / "p3.ppm"), "plain PPM is rejected");
+}
+
+void CheckStreamingDecomposition(const std::filesystem::path& dir) {
+  cv::Mat src = MakeDocument();
+  DocColorDecomposer dcd(src, Params());
+  std::vector<cv::Mat> layers = dcd.GetLayers();
+
+  PnmStripReader reader(dir / "document.ppm");
+  DocColorDecomposer streaming_dcd(reader, Params(), 64);
+  Check(streaming_dcd.CountLayers() == dcd.CountLayers(), "streaming decomposition finds the same number of the layers");
+
+  std::vector<cv::Mat> streamed_layers(streaming_dcd.CountLayers());
+  streaming_dcd.WriteLayers(reader, [&](int layer_idx) { return std::make_unique<MatStripWriter>(streamed_layers[layer_idx]); }, false, 64);
+
+  for (const auto& layer_idx : std::views::iota(0, std::min(dcd.CountLayers(), streaming_dcd.CountLayers()))) {
+    Check(AreEqual(streamed_layers[layer_idx], layers[layer_idx]), "streamed layer " + std::to_string(layer_idx) + " matches the in-memory one");
+  }
+
+  for (const auto& strip_rows : {0, -1}) {
+    bool construction_rejected = false;
+    try {
+      DocColorDecomposer rejected_dcd(reader, Params(), strip_rows);
+    } catch (const std::invalid_argument&) {
+      construction_rejected = true;
+    }
+    Check(construction_rejected, "streaming decomposition by strips of " + std::to_string(strip_rows) + " rows is rejected");
+
+    bool writing_rejected = false;
+    try {
+      streaming_dcd.WriteLayers(reader, [&](int layer_idx) { return std::make_unique<MatStripWriter>(streamed_layers[layer_idx]); }, false, strip_rows);
+    } catch (const std::invalid_argument&) {
+      writing_rejected = true;
+    }
+    Check(writing_rejected, "writing the layers by strips of " + std::to_string(strip_rows) + " rows is rejected");
+  }
+}
+
+}  // namespace
+
+}  // namespace doc_color_decomposer
+
+int main() {
+  std::filesystem::path dir = std::filesystem::temp_directory_path() / "doc_color_decomposer_strip_io_test";
+  std::filesystem::create_directories(dir);
+
+  doc_color_decomposer::CheckRoundTrip(dir);
+  doc_color_decomposer::CheckMaxValue(dir);
+  doc_color_decomposer::CheckStreamingDecomposition(dir);
+
+  std::filesystem::remove_all(dir);
+
+  return doc_color_decomposer::ReportChecks();
+}